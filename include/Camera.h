@@ -74,6 +74,14 @@ public:
         updateVectors();
     }
 
+    // jumps to an absolute orientation, e.g. one played back from a recorded path
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        updateVectors();
+    }
+
     void ProcessScroll(float yOffset)
     {
         Fov += yOffset;
@@ -88,6 +96,12 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // the current orientation seen from another position, e.g. one interpolated between two updates
+    glm::mat4 GetViewMatrix(const glm::vec3 &position)
+    {
+        return glm::lookAt(position, position + Front, Up);
+    }
+
 private:
     void updateVectors()
     {
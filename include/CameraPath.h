@@ -0,0 +1,39 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct CameraKey
+{
+    float time;         // seconds since the start of the path
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+// A camera flight as keys sorted by time, sampled with linear interpolation. Recorded from the
+// interactive camera with --record-path and played back by --bench, so a benchmark run always sees the
+// same views. The file is plain text, one "time x y z yaw pitch" key per line.
+class CameraPath
+{
+    public:
+        // keys have to come in increasing time
+        void Add(const CameraKey &key);
+        // keys looking from position at target, yaw and pitch are worked out as Camera uses them
+        void AddLookAt(float time, const glm::vec3 &position, const glm::vec3 &target);
+
+        bool Load(const char* path);
+        bool Save(const char* path) const;
+
+        bool Empty() const;
+        float Duration() const;
+        // past the end the path starts over
+        CameraKey Sample(float time) const;
+
+    private:
+        std::vector<CameraKey> keys;
+};
+
+#endif // CAMERA_PATH_H
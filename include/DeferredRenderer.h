@@ -0,0 +1,61 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad.h>
+
+#include "Shader.h"
+#include "ShaderPermutations.h"
+#include "StreamBuffer.h"
+#include "UniformBuffer.h"
+
+// Deferred shading for scenes with many point lights.
+// The geometry pass writes albedo + specular strength (RGBA8) and an octahedral encoded normal with the
+// material's shininess (RGB10_A2) next to a 24 bit depth buffer, 12 bytes per pixel; world positions are
+// rebuilt from depth.
+// The lighting pass then draws a full screen triangle for the ambient and scene light terms, and one
+// instanced sphere per point light, additively blended. Spheres are drawn back faces only with the
+// depth test reversed, so a light only shades pixels whose surface lies inside its volume and the
+// cost follows the lit pixels instead of objects x lights.
+class DeferredRenderer
+{
+    public:
+        DeferredRenderer(unsigned int maxLights = 4096);
+        ~DeferredRenderer();
+
+        // binds and clears the G-buffer, reallocating it when the size changed; draw opaque geometry with
+        // GeometryShaders() afterwards
+        void BeginGeometry(int width, int height);
+        ShaderPermutations &GeometryShaders();
+        // lights the G-buffer into the target framebuffer and writes the scene depth there as well,
+        // so forward passes drawn afterwards are depth tested against it
+        void Light(const PointLight* lights, unsigned int count, unsigned int targetFramebuffer = 0);
+
+    private:
+        ShaderPermutations geometryShaders;
+        Shader ambientShader;
+        Shader lightShader;
+        StreamBuffer lightInstances;
+        unsigned int maxLights;
+
+        unsigned int FBO;
+        unsigned int albedoSpecular;
+        unsigned int normal;
+        unsigned int depth;
+        int width;
+        int height;
+
+        unsigned int emptyVAO;
+        unsigned int sphereVAO;
+        unsigned int sphereVBO;
+        unsigned int sphereEBO;
+        unsigned int sphereIndexCount;
+
+        void createTargets();
+        void destroyTargets();
+        void createSphere();
+
+        DeferredRenderer(const DeferredRenderer&);
+        DeferredRenderer& operator=(const DeferredRenderer&);
+};
+
+#endif // DEFERRED_RENDERER_H
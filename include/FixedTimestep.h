@@ -0,0 +1,39 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+struct TimestepStats
+{
+    unsigned int frames;
+    unsigned int steps;
+    unsigned int clampedFrames;     // frames that hit the max steps clamp
+    double droppedSeconds;          // simulation time thrown away by the clamp
+};
+
+// Runs the simulation at a fixed rate no matter how fast frames come. Each frame adds its elapsed time to
+// an accumulator and Advance() says how many whole steps to run; what is left over, as a fraction of a
+// step, is how far rendering should interpolate from the previous state to the current one.
+// After a hitch at most maxSteps run and the rest of the backlog is dropped, so a slow frame can't
+// schedule even more work for the next one.
+class FixedTimestep
+{
+    public:
+        FixedTimestep(double stepSeconds = 1.0 / 60.0, unsigned int maxSteps = 5);
+
+        // adds the time since the last frame, returns the number of steps to run this frame
+        unsigned int Advance(double frameSeconds);
+        double Step() const;
+        // 0 renders the previous state, 1 the current one
+        float Alpha() const;
+
+        // counters since the last ResetStats()
+        const TimestepStats &Stats() const;
+        void ResetStats();
+
+    private:
+        double step;
+        unsigned int maxSteps;
+        double accumulator;
+        TimestepStats stats;
+};
+
+#endif // FIXED_TIMESTEP_H
@@ -0,0 +1,122 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+#include "GlyphAtlas.h"
+#include "SdfGenerator.h"
+
+// FreeType handles, declared here so the header doesn't drag in ft2build.h
+typedef struct FT_LibraryRec_ *FT_Library;
+typedef struct FT_FaceRec_ *FT_Face;
+
+// the range served by the flat per-size lookup tables, everything above goes through a hash map
+const unsigned int FONT_ASCII_GLYPHS = 128;
+
+// size SDF glyphs are generated at and how far, in pixels, the distance field reaches past the outline
+const unsigned int SDF_RASTER_SIZE = 32;
+const unsigned int SDF_SPREAD = 6;
+
+enum FontMode
+{
+    FONT_BITMAP,    // coverage bitmaps, rasterized separately for every pixel size
+    FONT_SDF        // one signed distance field per glyph, scaled to any pixel size when drawn
+};
+
+struct Glyph
+{
+    glm::ivec2 size;
+    glm::ivec2 bearing;
+    unsigned int advance;   // in 1/64 pixels, as FreeType reports it
+    glm::vec4 uv;           // u0, v0, u1, v1 of the glyph inside its page
+    int page;               // atlas layer, -1 for glyphs without pixels (whitespace, missing, not cached)
+};
+
+struct FontStats
+{
+    unsigned int rasterized;
+    unsigned int evictions;
+    unsigned int cachedGlyphs;
+    unsigned int pagesInUse;
+};
+
+// Glyph cache over one FreeType face. The face stays open and glyphs are rasterized the first time
+// they are asked for, for any codepoint and any pixel size, into the pages of a GlyphAtlas.
+// The atlas has a fixed number of pages (the memory budget). When they are all full the least
+// recently used page is emptied and its glyphs are rasterized again if they show up later;
+// a page used during the current frame is never evicted.
+// In FONT_SDF mode every pixel size shares the glyphs generated at SDF_RASTER_SIZE. They are generated
+// on worker threads: until a glyph is ready GetGlyph() returns its metrics without pixels.
+class Font
+{
+    public:
+        FontMode Mode;
+
+        Font(const char* path, FontMode mode = FONT_BITMAP, unsigned int budgetBytes = 2 * 1024 * 1024);
+        ~Font();
+
+        // metrics are in pixels at RasterSize(pixelSize), scale by pixelSize / RasterSize(pixelSize) to draw
+        Glyph GetGlyph(unsigned int codepoint, unsigned int pixelSize);
+        unsigned int RasterSize(unsigned int pixelSize) const;
+        // advances the LRU clock, call once per frame before any GetGlyph()
+        void BeginFrame();
+        // uploads glyphs rasterized (or generated by the SDF workers) since the last call, call before drawing text
+        void Upload();
+        unsigned int TextureID() const;
+        const FontStats &Stats() const;
+        // changes whenever glyphs already handed out may have moved (a page was evicted, SDF glyphs arrived),
+        // anything holding on to Glyph uvs has to look them up again
+        unsigned int Generation() const;
+        // keeps a page from being evicted this frame, for callers that reuse glyphs without GetGlyph()
+        void Touch(int page);
+
+    private:
+        struct SizeTable
+        {
+            unsigned int pixelSize;
+            int ascii[FONT_ASCII_GLYPHS];   // slot in glyphs, -1 when not cached
+        };
+
+        struct CachedGlyph
+        {
+            Glyph glyph;
+            unsigned int codepoint;
+            unsigned int pixelSize;
+        };
+
+        FT_Library library;
+        FT_Face face;
+        unsigned int faceSize;
+        SdfGenerator* sdf;
+        GlyphAtlas atlas;
+        unsigned int frame;
+        unsigned int exhaustedFrame;
+        unsigned int generation;
+        int openPage;
+        int pagesUsed;
+        std::vector<unsigned int> pageLastUsed;
+        std::vector<std::vector<int> > pageSlots;
+
+        std::vector<SizeTable> sizes;
+        int lastSize;
+        std::unordered_map<unsigned long long, int> others;
+        // advances of SDF glyphs still being generated, loaded once when the glyph is first asked for
+        std::unordered_map<unsigned int, unsigned int> pendingAdvances;
+        std::vector<CachedGlyph> glyphs;
+        std::vector<int> freeSlots;
+        FontStats stats;
+
+        int* findSlot(unsigned int codepoint, unsigned int pixelSize);
+        int rasterize(unsigned int codepoint, unsigned int pixelSize, Glyph &glyph);
+        int store(unsigned int codepoint, unsigned int pixelSize, Glyph &glyph, const unsigned char* pixels);
+        int allocatePage(int w, int h, glm::ivec2 &origin);
+        void evictPage(int page);
+
+        Font(const Font&);
+        Font& operator=(const Font&);
+};
+
+#endif // FONT_H
@@ -0,0 +1,52 @@
+#ifndef FRAME_PACKET_H
+#define FRAME_PACKET_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "UniformBuffer.h"
+
+enum ShadingPath
+{
+    SHADING_FORWARD,
+    SHADING_DEFERRED,
+    SHADING_CLUSTERED,
+    SHADING_PATH_COUNT
+};
+const char* const SHADING_PATH_NAMES[SHADING_PATH_COUNT] = { "forward", "deferred", "clustered" };
+
+// the meshes the renderer knows how to draw
+enum SceneMesh
+{
+    MESH_BACKPACK,
+    MESH_LIGHT_CUBE
+};
+
+struct DrawCommand
+{
+    SceneMesh mesh;
+    ObjectBlock object;
+};
+
+// Everything the render thread needs to draw one frame, filled in by the simulation thread.
+// Packets live in the FrameQueue ring and are reused, so the vectors keep their capacity and a
+// steady frame allocates nothing.
+struct FramePacket
+{
+    unsigned int frameNumber;
+    float time;
+    float deltaTime;
+    int screenWidth;
+    int screenHeight;
+    ShadingPath shadingPath;
+
+    PerFrameBlock perFrame;
+    glm::vec3 ambientLight;     // clear color and material ambient
+    glm::vec3 lightPos;
+    glm::vec3 lightColor;
+    std::vector<PointLight> pointLights;
+    std::vector<DrawCommand> draws;
+};
+
+#endif // FRAME_PACKET_H
@@ -0,0 +1,61 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+
+#include "FramePacket.h"
+
+// Hands frame packets from the simulation thread to the render thread through a ring of maxDepth
+// packets. The simulation fills packet N+1 while the render thread submits packet N; once maxDepth
+// packets are queued or being rendered BeginWrite() blocks, which bounds how many frames input can be
+// ahead of the screen. Every packet is rendered, in order.
+// One producer and one consumer: both sides only touch the two atomic counters on the way through,
+// the mutex and condition variable are there for a side that has to sleep.
+class FrameQueue
+{
+    public:
+        static const unsigned int MAX_DEPTH = 3;
+
+        // 2 double buffers, 3 triple buffers, 1 runs the threads in lockstep
+        FrameQueue(unsigned int maxDepth = 2);
+
+        // producer: the packet to fill next, NULL once the queue is closed
+        FramePacket* BeginWrite();
+        void EndWrite();
+        // consumer: the oldest published packet, NULL once the queue is closed and drained
+        FramePacket* BeginRead();
+        void EndRead();
+
+        // wakes both sides, either of them may close
+        void Close();
+        unsigned int MaxDepth() const;
+        void WriteStatsJson(std::ostream &out) const;
+
+    private:
+        FramePacket packets[MAX_DEPTH];
+        unsigned int maxDepth;
+
+        std::atomic<unsigned long long> written;    // packets published by the producer
+        std::atomic<unsigned long long> released;   // packets the consumer is done with
+        unsigned long long readCursor;              // consumer side only
+        std::atomic<bool> closed;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::atomic<int> sleeping;
+        // times a side found the queue full or empty and had to wait
+        std::atomic<unsigned int> producerWaits;
+        std::atomic<unsigned int> consumerWaits;
+
+        template <typename Ready>
+        void waitUntil(Ready ready);
+        void wakeOther();
+
+        FrameQueue(const FrameQueue&);
+        FrameQueue& operator=(const FrameQueue&);
+};
+
+#endif // FRAME_QUEUE_H
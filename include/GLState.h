@@ -0,0 +1,85 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad.h>
+
+#include <ostream>
+
+// Thin shadow of the GL state the renderer touches. Every call compares against what is already
+// bound and only reaches the driver when something would actually change. All GL binds outside of
+// this file should go through it, otherwise the shadow goes stale; call Invalidate() after code that
+// bypasses it.
+
+const unsigned int GL_STATE_TEXTURE_UNITS = 32;
+const unsigned int GL_STATE_BUFFER_BINDINGS = 16;
+
+enum StateCall
+{
+    CALL_PROGRAM,
+    CALL_VERTEX_ARRAY,
+    CALL_ACTIVE_TEXTURE,
+    CALL_TEXTURE,
+    CALL_BUFFER,
+    CALL_BUFFER_RANGE,
+    CALL_FRAMEBUFFER,
+    CALL_CAPABILITY,
+    CALL_DEPTH,
+    CALL_BLEND,
+    CALL_VIEWPORT,
+    CALL_CULL_FACE,
+    CALL_SAMPLER,
+    STATE_CALL_COUNT
+};
+
+struct GLStateStats
+{
+    unsigned int issued[STATE_CALL_COUNT];
+    unsigned int redundant[STATE_CALL_COUNT];
+    unsigned int drawCalls;
+    unsigned long long triangles;
+};
+
+class GLState
+{
+    public:
+        static void UseProgram(unsigned int program);
+        static void BindVertexArray(unsigned int vao);
+        static void ActiveTexture(unsigned int unit);
+        // binds to the given unit, switching the active unit only when the binding changes
+        static void BindTexture(unsigned int unit, GLenum target, unsigned int texture);
+        static void BindSampler(unsigned int unit, unsigned int sampler);
+        static void BindBuffer(GLenum target, unsigned int buffer);
+        static void BindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+        static void BindFramebuffer(GLenum target, unsigned int framebuffer);
+        static void Enable(GLenum capability);
+        static void Disable(GLenum capability);
+        static void DepthFunc(GLenum func);
+        static void DepthMask(bool write);
+        static void BlendFunc(GLenum src, GLenum dst);
+        static void Viewport(int x, int y, int width, int height);
+        static void CullFace(GLenum face);
+
+        // draws go straight to the driver, they only pass through here to be counted
+        static void DrawArrays(GLenum mode, int first, int count);
+        static void DrawElements(GLenum mode, int count, GLenum type, const void* indices);
+        static void DrawElementsInstanced(GLenum mode, int count, GLenum type, const void* indices, int instances);
+        // one draw call for all drawCount ranges
+        static void MultiDrawElementsBaseVertex(GLenum mode, const int* counts, GLenum type, const void* const* indices,
+                                                int drawCount, const int* baseVertices);
+
+        // call when deleting GL objects so a recycled name is not mistaken for a live binding
+        static void ForgetTexture(unsigned int texture);
+        static void ForgetSampler(unsigned int sampler);
+        static void ForgetBuffer(unsigned int buffer);
+        static void ForgetVertexArray(unsigned int vao);
+        static void ForgetProgram(unsigned int program);
+        // marks everything unknown, the next call of each kind always reaches the driver
+        static void Invalidate();
+
+        // closes the current frame's counters, LastFrame() returns them until the next EndFrame()
+        static void EndFrame();
+        static const GLStateStats &LastFrame();
+        static void WriteStatsJson(std::ostream &out);
+};
+
+#endif // GL_STATE_H
@@ -0,0 +1,55 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Single-channel GL_TEXTURE_2D_ARRAY whose layers are pages that glyph bitmaps are packed into.
+// Each page uses a shelf packer: glyphs are placed left to right on horizontal shelves, and a new
+// shelf is opened below the last one when no existing shelf is tall and wide enough.
+// Every page shares the one texture binding, so text spread over several pages is still one draw.
+class GlyphAtlas
+{
+    public:
+        unsigned int TextureID;
+        int Width;
+        int Height;
+        int Pages;
+
+        GlyphAtlas(int width, int height, int pages);
+        ~GlyphAtlas();
+
+        // finds room for a w x h bitmap on the page, returns false when the page is full
+        bool Pack(int page, int w, int h, glm::ivec2 &origin);
+        // copies a tightly packed bitmap into the CPU copy of the page
+        void Write(int page, glm::ivec2 origin, int w, int h, const unsigned char* bitmap);
+        // sends the rows written since the last upload to the texture, one call per touched page
+        void Upload();
+        // forgets every glyph packed on the page so it can be reused
+        void Clear(int page);
+
+    private:
+        struct Shelf
+        {
+            int y;
+            int height;
+            int x;
+        };
+
+        struct Page
+        {
+            std::vector<Shelf> shelves;
+            std::vector<unsigned char> pixels;   // allocated on first use
+            int dirtyMinY;
+            int dirtyMaxY;
+        };
+
+        std::vector<Page> pages;
+
+        GlyphAtlas(const GlyphAtlas&);
+        GlyphAtlas& operator=(const GlyphAtlas&);
+};
+
+#endif // GLYPH_ATLAS_H
@@ -0,0 +1,49 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "Profiler.h"
+
+// GPU zones for the Profiler, on the thread the GL context is current on. A zone puts a pair of
+// GL_TIMESTAMP queries around the commands, kept in a ring and read back only once the driver reports
+// them available, and lands on a "GPU" track aligned with the CPU clock. Use the PROFILE_GPU_ macros,
+// with PROFILER_DISABLED defined they compile out and no query objects are made.
+class GpuProfiler
+{
+    public:
+        // zones that can wait for their results at once, more are dropped rather than stalling
+        static const unsigned int ZONES_IN_FLIGHT = 256;
+
+        static void Init();
+        static void Shutdown();
+        static void Begin(const char* name);
+        static void End();
+        // once per frame, reads back the zones whose queries are done
+        static void Collect();
+};
+
+class GpuProfileZone
+{
+    public:
+        GpuProfileZone(const char* name)
+        {
+            GpuProfiler::Begin(name);
+        }
+        ~GpuProfileZone()
+        {
+            GpuProfiler::End();
+        }
+};
+
+#ifdef PROFILER_DISABLED
+#define PROFILE_GPU_ZONE(name)
+#define PROFILE_GPU_INIT()
+#define PROFILE_GPU_COLLECT()
+#define PROFILE_GPU_SHUTDOWN()
+#else
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
+#define PROFILE_GPU_INIT() GpuProfiler::Init()
+#define PROFILE_GPU_COLLECT() GpuProfiler::Collect()
+#define PROFILE_GPU_SHUTDOWN() GpuProfiler::Shutdown()
+#endif
+
+#endif // GPU_PROFILER_H
@@ -0,0 +1,33 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad.h>
+
+// Measures the GPU time spent between Begin() and End() with GL_TIME_ELAPSED queries.
+// Queries are kept in a small ring and only read back once the driver reports them available,
+// so timing a pass never stalls the CPU waiting for the GPU to catch up.
+const unsigned int GPU_TIMER_QUERIES = 4;
+
+class GpuTimer
+{
+    public:
+        GpuTimer();
+        ~GpuTimer();
+        void Begin();
+        void End();
+        // collects every finished query, call once per frame
+        void Poll();
+        // average over the samples collected since the last Reset(), in milliseconds
+        double AverageMs() const;
+        unsigned int Samples() const;
+        void Reset();
+
+    private:
+        unsigned int queries[GPU_TIMER_QUERIES];
+        unsigned int writeIndex;
+        unsigned int pending;
+        unsigned long long totalNs;
+        unsigned int sampleCount;
+};
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,178 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*JobFunction)(void* data);
+
+class JobCounter;
+
+struct Job
+{
+    JobFunction function;
+    void* data;
+    JobCounter* counter;    // decremented once the job ran, may be NULL
+    int owner;              // the thread whose pool the slot belongs to, -1 for main thread jobs
+    Job* nextFree;          // next free slot while the slot is in a free list
+};
+
+// Counts the unfinished jobs that were started with it. Jobs started with a counter as their dependency
+// are held back until it reaches zero, then pushed by the thread that finished the last job.
+// A counter can be reused or destroyed once Done() returned true, so the last job only lets go of it
+// under the lock Done() takes when it sees zero.
+class JobCounter
+{
+    public:
+        JobCounter();
+
+        bool Done() const;
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<int> pending;
+        mutable std::mutex mutex;
+        std::vector<Job*> continuations;
+
+        JobCounter(const JobCounter&);
+        JobCounter& operator=(const JobCounter&);
+};
+
+// Work-stealing job scheduler. The thread that creates the system is thread 0 and every worker thread
+// after it gets an index of its own; each of them owns a Chase-Lev deque it pushes and pops at the
+// bottom without locks while idle threads steal from the top of the others'. Jobs are plain function
+// pointers with a data pointer, their slots come out of a per-thread pool so starting one never allocates.
+// A slot goes back to its pool once its job has run, whichever thread ran it; when the pool is empty Run()
+// runs the job right away, or runs other jobs until a slot frees up if the job waits on a dependency.
+// Waiting on a counter runs other jobs instead of blocking, so jobs may start and wait on jobs of their own.
+// GL calls can only happen on the thread that owns the context: RunOnMainThread() queues a job that only
+// thread 0 runs, from PumpMainThread() or while it waits.
+class JobSystem
+{
+    public:
+        // jobs a thread can have started and not yet finished, a power of two; past it Run() runs them itself
+        static const unsigned int MAX_JOBS_PER_THREAD = 4096;
+
+        // threads = 0 uses every core but one next to the calling thread
+        JobSystem(unsigned int threads = 0);
+        // all started jobs have to be waited for before
+        ~JobSystem();
+
+        // only from thread 0 or a job; counter and dependency may be NULL
+        void Run(JobFunction function, void* data, JobCounter* counter, JobCounter* dependency = NULL);
+        void RunOnMainThread(JobFunction function, void* data, JobCounter* counter);
+        // runs jobs until the counter is done
+        void Wait(JobCounter* counter);
+        // thread 0 only: like Wait() but runs nothing except main thread jobs, so one that becomes ready starts
+        // right away instead of after whatever job thread 0 took meanwhile. Without workers it is Wait()
+        void WaitOnMainThread(JobCounter* counter);
+        // runs the main thread jobs queued so far, thread 0 only
+        void PumpMainThread();
+
+        // calls body(begin, end) over [0, count) in chunks of at most grain items and waits for all of them
+        template <typename Body>
+        void ParallelFor(unsigned int count, unsigned int grain, const Body &body);
+
+        // worker threads plus thread 0
+        unsigned int ThreadCount() const;
+
+    private:
+        // Chase-Lev work-stealing deque (Le et al., "Correct and efficient work-stealing for weak memory
+        // models"), fixed size: a full deque makes Push() fail and the job is run right away instead
+        class Deque
+        {
+            public:
+                Deque();
+                bool Push(Job* job);
+                Job* Pop();
+                Job* Steal();
+
+            private:
+                std::atomic<long long> top;
+                std::atomic<long long> bottom;
+                std::atomic<Job*> jobs[MAX_JOBS_PER_THREAD];
+        };
+
+        struct Thread
+        {
+            Deque deque;
+            Job pool[MAX_JOBS_PER_THREAD];
+            // free slots only the owning thread takes from
+            Job* free;
+            // slots other threads released, the owner takes all of them at once when free runs dry
+            std::atomic<Job*> released;
+            unsigned int random;
+        };
+
+        std::vector<Thread*> threads;
+        std::vector<std::thread> workers;
+        std::thread::id mainThread;
+
+        // idle workers sleep until a job is pushed
+        std::atomic<int> queued;
+        std::atomic<int> sleeping;
+        std::atomic<bool> stopping;
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+
+        std::mutex mainMutex;
+        std::vector<Job> mainJobs;
+        std::vector<Job> mainRunning;
+
+        int currentThread() const;
+        Job* allocate(int thread);
+        void release(Job* job);
+        void push(int thread, Job* job);
+        Job* find(int thread);
+        void execute(int thread, Job* job);
+        void finish(int thread, JobCounter* counter);
+        void work(int thread);
+
+        JobSystem(const JobSystem&);
+        JobSystem& operator=(const JobSystem&);
+};
+
+template <typename Body>
+void JobSystem::ParallelFor(unsigned int count, unsigned int grain, const Body &body)
+{
+    struct Range
+    {
+        const Body* body;
+        unsigned int begin;
+        unsigned int end;
+
+        static void Execute(void* data)
+        {
+            Range* range = (Range*)data;
+            (*range->body)(range->begin, range->end);
+        }
+    };
+
+    if (grain == 0)
+        grain = 1;
+    unsigned int chunks = (count + grain - 1) / grain;
+    if (chunks <= 1)
+    {
+        if (count > 0)
+            body(0, count);
+        return;
+    }
+
+    std::vector<Range> ranges(chunks);
+    JobCounter counter;
+    // the calling thread pops the last chunks itself while the first ones get stolen
+    for (unsigned int i = 0; i < chunks; i++)
+    {
+        ranges[i].body = &body;
+        ranges[i].begin = i * grain;
+        ranges[i].end = i * grain + grain < count ? i * grain + grain : count;
+        Run(&Range::Execute, &ranges[i], &counter);
+    }
+    Wait(&counter);
+}
+
+#endif // JOB_SYSTEM_H
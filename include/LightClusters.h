@@ -0,0 +1,104 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "JobSystem.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "UniformBuffer.h"
+
+// froxel grid: screen tiles x screen tiles x exponential depth slices
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 9;
+const unsigned int CLUSTER_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// texture units the clustered shader reads its buffers from, clear of the material maps
+const unsigned int CLUSTER_GRID_UNIT = 4;
+const unsigned int CLUSTER_INDEX_UNIT = 5;
+const unsigned int CLUSTER_LIGHT_UNIT = 6;
+
+struct ClusterStats
+{
+    double binMs;       // wall time of the parallel binning
+    double uploadMs;    // compacting the per-slice lists into the stream buffer
+    unsigned int lights;
+    unsigned int indices;
+    unsigned int maxLightsPerCluster;
+};
+
+// Clustered forward light culling. The view frustum is cut into CLUSTER_X x CLUSTER_Y x CLUSTER_Z froxels,
+// depth slices spaced exponentially between the near and far planes of the projection. Every frame the
+// light spheres are binned into the froxels they touch on the CPU: depth slices are spread over the
+// job system's threads, and each slice tests its lights against its froxel AABBs four at a time with SSE.
+// The result goes through a StreamBuffer to three texture buffers: per froxel an (offset, count) pair,
+// one compact list of 16 bit light indices, and the lights themselves. clustered_fragment.fs then only
+// loops over the lights of the froxel its fragment falls in.
+class LightClusters
+{
+    public:
+        LightClusters(JobSystem &jobs, unsigned int maxLights = 4096, unsigned int maxIndices = 256 * 1024);
+        ~LightClusters();
+
+        // bins the lights for this view and uploads them, call once per frame before drawing; false when the
+        // stream buffer had no room for them, the clustered draws of the frame are skipped then
+        bool Build(const PointLight* lights, unsigned int count, const glm::mat4 &view, const glm::mat4 &projection,
+                   int screenWidth, int screenHeight);
+        // binds the buffers and sets the lookup uniforms, the shader has to be in use
+        void Bind(Shader &shader);
+        // fences this frame's region, call after the last draw that used the clusters
+        void EndFrame();
+        const ClusterStats &LastFrame() const;
+
+    private:
+        struct Aabb
+        {
+            glm::vec3 min;
+            glm::vec3 max;
+        };
+
+        // what one depth slice produces, written by a single worker
+        struct Slice
+        {
+            std::vector<float> x, y, z, radius;     // view space candidates, padded to a multiple of 4
+            std::vector<unsigned short> candidates;
+            std::vector<unsigned short> indices;
+            unsigned int offsets[CLUSTER_X * CLUSTER_Y];
+            unsigned int counts[CLUSTER_X * CLUSTER_Y];
+        };
+
+        JobSystem &jobs;
+        StreamBuffer stream;
+        unsigned int maxLights;
+        unsigned int maxIndices;
+        unsigned int gridTexture;
+        unsigned int indexTexture;
+        unsigned int lightTexture;
+
+        glm::mat4 clusterProjection;
+        Aabb aabbs[CLUSTER_COUNT];
+        float sliceNear[CLUSTER_Z + 1];
+        glm::vec2 tileScale;
+        glm::vec2 depthParams;
+        GLintptr gridBase;
+        GLintptr indexBase;
+        GLintptr lightBase;
+
+        // lights in view space, structure of arrays
+        std::vector<float> viewX, viewY, viewZ, viewRadius;
+        unsigned int lightCount;
+        Slice slices[CLUSTER_Z];
+        ClusterStats stats;
+
+        void buildAabbs(const glm::mat4 &projection);
+        void binSlice(unsigned int z);
+
+        LightClusters(const LightClusters&);
+        LightClusters& operator=(const LightClusters&);
+};
+
+#endif // LIGHT_CLUSTERS_H
@@ -0,0 +1,92 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "TextureArrays.h"
+#include "UniformBuffer.h"
+
+// the maps a material can have, in texture unit order
+enum MaterialMap
+{
+    MAP_DIFFUSE,
+    MAP_SPECULAR,
+    MAP_NORMAL,
+    MATERIAL_MAP_COUNT
+};
+
+// the maps go to this unit and the ones after it, in MaterialMap order. The units below belong to the other
+// passes, which sample their textures without the material sampler object
+const unsigned int MATERIAL_TEXTURE_UNIT = 8;
+// the sampler uniform of each map, in MaterialMap order; Shader points them at their units after linking
+extern const char* const MATERIAL_MAP_UNIFORMS[MATERIAL_MAP_COUNT];
+
+// what the model file says about a material, read at import before there is a context
+struct MaterialInfo
+{
+    glm::vec3 diffuse;                  // Kd
+    glm::vec3 specular;                 // Ks
+    float shininess;                    // Ns
+    int maps[MATERIAL_MAP_COUNT];       // the model's texture index of each map, -1 when it has none
+};
+
+// the MaterialFeature bits of the maps it names, known before the material is built
+unsigned int MaterialInfoFeatures(const MaterialInfo &info);
+
+// A material as the shaders see it, fixed once built: its parameters at its index in the library's block,
+// and the texture array each map samples at MATERIAL_TEXTURE_UNIT + its MaterialMap.
+class Material
+{
+    public:
+        Material(unsigned int index, const MaterialInfo &info, const TextureLayer maps[MATERIAL_MAP_COUNT]);
+
+        unsigned int Index() const;
+        // the MaterialFeature bits of the maps it has arrays for, picks the shader variant
+        unsigned int Features() const;
+        // the array bound to the map's unit, 0 when the material has no such map
+        unsigned int Texture(MaterialMap map) const;
+        const MaterialParams &Params() const;
+
+    private:
+        unsigned int index;
+        unsigned int features;
+        unsigned int textures[MATERIAL_MAP_COUNT];
+        MaterialParams params;
+};
+
+// The materials of one model. Their parameter blocks sit in one static uniform buffer, so drawing with any
+// of them is one range bind of MATERIAL_BINDING, and all maps are read through one sampler object.
+class MaterialLibrary
+{
+    public:
+        // owner is the asset the buffer is booked under in MemoryTracker
+        MaterialLibrary(const std::string &owner);
+        ~MaterialLibrary();
+
+        // GL thread; past MAX_MATERIALS nothing is added and NULL is returned, the meshes using the
+        // material are left out of the batch
+        const Material* Add(const MaterialInfo &info, const TextureLayer maps[MATERIAL_MAP_COUNT]);
+        const Material &Get(unsigned int index) const;
+        unsigned int Count() const;
+        // binds the block and the samplers, GLState skips what is bound already
+        void Bind() const;
+        // binds the material's arrays to their units, only the ones that differ reach the driver
+        void BindTextures(const Material &material) const;
+
+    private:
+        std::string owner;
+        std::vector<Material*> materials;
+        unsigned int UBO;
+        unsigned int sampler;
+        // materials Add() turned away, the error is printed for the first one
+        unsigned int refused;
+
+        MaterialLibrary(const MaterialLibrary&);
+        MaterialLibrary& operator=(const MaterialLibrary&);
+};
+
+#endif // MATERIAL_H
@@ -0,0 +1,63 @@
+#ifndef MATERIAL_BATCH_H
+#define MATERIAL_BATCH_H
+
+#include <glad.h>
+
+#include <string>
+#include <vector>
+
+#include "Material.h"
+#include "Mesh.h"
+#include "NodeHierarchy.h"
+#include "ShaderPermutations.h"
+
+// The meshes of a model in one vertex and one index buffer, drawn with one glMultiDrawElementsBaseVertex per
+// group of meshes that share a shader variant and the texture arrays their maps were packed into. The index
+// of a mesh's material is a per-vertex attribute next to the vertices (location 5); the shaders find its
+// parameters and array layers in the library's block, so switching material between meshes needs no
+// rebinding. Meshes whose maps landed in the same arrays, which is every mesh whose maps have the same
+// formats and sizes, end up in one group whatever their material. The node a mesh hangs from comes the same way
+// (location 6), as an index into the batch's Nodes block, which holds the matrices of the nodes that carry
+// meshes.
+class MaterialBatch
+{
+    public:
+        // owner is the asset the buffers are booked under in MemoryTracker
+        MaterialBatch(const std::string &owner);
+        ~MaterialBatch();
+
+        // Mesh::material indexes the library, which has to outlive the batch, Mesh::node the hierarchy, whose
+        // matrices are uploaded right away; GL thread only. Meshes whose material the library turned away are
+        // left out, and listed in one error per build
+        void Build(const std::vector<Mesh> &meshes, const MaterialLibrary &library, const NodeHierarchy &nodes);
+        // uploads the world matrices of the mesh nodes again, after the hierarchy updated them
+        void UpdateNodes(const NodeHierarchy &nodes);
+        void Draw(ShaderPermutations &shaders);
+        unsigned int GroupCount() const;
+
+    private:
+        struct Group
+        {
+            const Material* material;   // the first one, the others bind the same arrays
+            std::vector<GLsizei> counts;
+            std::vector<void*> offsets;
+            std::vector<GLint> baseVertices;
+        };
+
+        std::string owner;
+        std::vector<Group> groups;
+        const MaterialLibrary* library;
+        // the hierarchy index of the node behind each entry of the Nodes block
+        std::vector<unsigned int> meshNodes;
+        unsigned int VAO;
+        unsigned int VBO;
+        unsigned int materialVBO;
+        unsigned int nodeVBO;
+        unsigned int EBO;
+        unsigned int nodesUBO;
+
+        MaterialBatch(const MaterialBatch&);
+        MaterialBatch& operator=(const MaterialBatch&);
+};
+
+#endif // MATERIAL_BATCH_H
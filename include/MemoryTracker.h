@@ -0,0 +1,62 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <glad.h>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+enum MemoryCategory
+{
+    MEMORY_GEOMETRY,        // vertex and index data
+    MEMORY_TEXTURE,         // material textures
+    MEMORY_FONT,            // glyph atlases and text geometry
+    MEMORY_STAGING,         // rings rewritten every frame
+    MEMORY_RENDER_TARGET,   // framebuffer attachments
+    MEMORY_CATEGORY_COUNT
+};
+
+enum MemoryKind
+{
+    KIND_BUFFER,
+    KIND_TEXTURE,
+    KIND_RENDERBUFFER,
+    KIND_CPU,               // heap memory, keyed by its address
+    MEMORY_KIND_COUNT
+};
+
+struct MemoryTotals
+{
+    size_t live;
+    size_t highWater;
+    unsigned int allocations;
+};
+
+// Books every GL buffer, texture and renderbuffer the app creates, and the CPU copies it keeps around,
+// under a category and an owner (the asset or subsystem it belongs to). Sizes are what was asked for,
+// drivers add padding and alignment on top. Code that creates or re-specifies storage calls Track(),
+// code that deletes it calls Release(); whatever is still tracked when the GL context goes away leaked.
+// Safe to call from any thread.
+class MemoryTracker
+{
+    public:
+        // a new allocation, or the new size of one whose storage was specified again
+        static void Track(MemoryKind kind, unsigned long long id, MemoryCategory category, size_t bytes, const std::string &owner);
+        static void Release(MemoryKind kind, unsigned long long id);
+
+        // bytes of a texture's storage, mipmaps add a third on top of level 0
+        static size_t TextureBytes(GLenum internalFormat, int width, int height, int layers = 1, bool mipmapped = false);
+
+        static MemoryTotals Category(MemoryCategory category);
+        // every category together, GL objects and CPU memory apart
+        static MemoryTotals Gpu();
+        static MemoryTotals Cpu();
+
+        // totals and high-water marks per category, then live bytes per owner
+        static void WriteJson(std::ostream &out);
+        // prints every GL object still tracked and returns how many there are
+        static unsigned int ReportLeaks(std::ostream &out);
+};
+
+#endif // MEMORY_TRACKER_H
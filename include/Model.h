@@ -14,8 +14,18 @@
 #include <assimp/postprocess.h>
 
 #include <Mesh.h>
+#include <Material.h>
+#include <MaterialBatch.h>
+#include <NodeHierarchy.h>
+#include <TextureArrays.h>
 #include <Shader.h>
+#include <ShaderPermutations.h>
+#include <GLState.h>
+#include <Profiler.h>
+#include <MemoryTracker.h>
+#include <JobSystem.h>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -24,7 +34,16 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// pixels of an image file, decoded on any thread and uploaded on the GL thread
+struct DecodedImage
+{
+    unsigned char* data;
+    int width;
+    int height;
+    int components;
+};
+
+bool DecodeImage(const string &filename, DecodedImage &image);
 
 class Model
 {
@@ -32,26 +51,109 @@ public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    vector<MaterialInfo> materialInfos;    // one per material of the file, Mesh::material indexes them
+    // the file's node tree, Mesh::node indexes it; set a local matrix to move a node and its meshes
+    NodeHierarchy nodes;
     string directory;
     bool gammaCorrection;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. Only parses it and needs no context, so it can run on
+    // any thread; DecodeTextures() and then Upload() on the GL thread have to follow before Draw()
+    Model(string const &path, bool gamma = false) : gammaCorrection(gamma), textureArrays(NULL), materials(NULL), batch(NULL)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // decodes the image files of textures_loaded, spread over the job threads
+    void DecodeTextures(JobSystem &jobs)
     {
+        PROFILE_ZONE("Model::DecodeTextures");
+        // the images are stored top row first, GL wants the bottom row first
+        stbi_set_flip_vertically_on_load(true);
+        jobs.ParallelFor(textures_loaded.size(), 1, [this](unsigned int begin, unsigned int end)
+        {
+            for(unsigned int i = begin; i < end; i++)
+                DecodeImage(directory + '/' + textures_loaded[i].path, images[i]);
+        });
+    }
+
+    // packs the textures into texture arrays, builds the materials on them and the meshes into one batch,
+    // GL thread only
+    void Upload()
+    {
+        PROFILE_ZONE("Model::Upload");
+        textureArrays = new TextureArrays(directory);
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            textureArrays->Add(images[i].data, images[i].width, images[i].height, images[i].components);
+        textureArrays->Build();
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            TextureLayer placed = textureArrays->Layer(i);
+            textures_loaded[i].id = placed.texture;
+            textures_loaded[i].layer = placed.layer;
+            stbi_image_free(images[i].data);
+            images[i].data = NULL;
+        }
+        materials = new MaterialLibrary(directory);
+        for(unsigned int i = 0; i < materialInfos.size(); i++)
+        {
+            TextureLayer maps[MATERIAL_MAP_COUNT];
+            for(unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+            {
+                maps[map].texture = 0;
+                maps[map].layer = 0;
+                if(materialInfos[i].maps[map] >= 0)
+                    maps[map] = textureArrays->Layer(materialInfos[i].maps[map]);
+            }
+            materials->Add(materialInfos[i], maps);
+        }
+        batch = new MaterialBatch(directory);
+        batch->Build(meshes, *materials, nodes);
+    }
+
+    ~Model()
+    {
+        // the batch points at the materials, they at the arrays
+        delete batch;
+        delete materials;
+        delete textureArrays;
+        // decoded but never uploaded
+        for(unsigned int i = 0; i < images.size(); i++)
+            stbi_image_free(images[i].data);
+        MemoryTracker::Release(KIND_CPU, (unsigned long long)(size_t)this);
+    }
+
+    // draws the model, one multi-draw per group of meshes that share a shader variant and texture arrays
+    void Draw(ShaderPermutations &shaders)
+    {
+        PROFILE_ZONE("Model::Draw");
+        // only uploads when a node was moved since the last draw
+        if(nodes.Update() > 0 && batch)
+            batch->UpdateNodes(nodes);
+        if(batch)
+            batch->Draw(shaders);
+    }
+
+    // the distinct MaterialFeature combinations of the meshes' materials, the variants a Draw will ask for
+    vector<unsigned int> MaterialFeatures() const
+    {
+        vector<unsigned int> features;
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        {
+            if(meshes[i].material >= materialInfos.size())
+                continue;
+            unsigned int bits = MaterialInfoFeatures(materialInfos[meshes[i].material]);
+            if(std::find(features.begin(), features.end(), bits) == features.end())
+                features.push_back(bits);
+        }
+        return features;
     }
 
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        PROFILE_ZONE("Model::loadModel");
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -64,35 +166,58 @@ private:
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // every material once, however many meshes use it
+        for(unsigned int i = 0; i < scene->mNumMaterials; i++)
+            materialInfos.push_back(processMaterial(scene->mMaterials[i]));
+
+        // process ASSIMP's root node recursively, the nodes are added parents first
+        processNode(scene->mRootNode, scene, -1);
+        nodes.Update();
+
+        // the meshes keep their vertices and indices after the upload
+        size_t cpuBytes = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            cpuBytes += meshes[i].vertices.size() * sizeof(Vertex) + meshes[i].indices.size() * sizeof(unsigned int);
+        MemoryTracker::Track(KIND_CPU, (unsigned long long)(size_t)this, MEMORY_GEOMETRY, cpuBytes, directory);
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // processes a node in a recursive fashion. Adds it to the hierarchy below parent, processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode *node, const aiScene *scene, int parent)
     {
+        unsigned int index = nodes.Add(parent, toMat4(node->mTransformation));
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshes.push_back(processMesh(mesh, scene, index));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // assimp stores a matrix row by row, glm column by column
+    static glm::mat4 toMat4(const aiMatrix4x4 &matrix)
+    {
+        glm::mat4 result;
+        for(unsigned int row = 0; row < 4; row++)
+        {
+            for(unsigned int column = 0; column < 4; column++)
+                result[column][row] = matrix[row][column];
+        }
+        return result;
+    }
+
+    Mesh processMesh(aiMesh *mesh, const aiScene *scene, unsigned int node)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -141,106 +266,74 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, DIFFUSE);
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, SPECULAR);
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        /*
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, NORMAL);
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, HEIGHT);
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        */
+        // the material was read with the others in loadModel, the mesh only keeps its index
+        return Mesh(vertices, indices, mesh->mMaterialIndex, node);
+    }
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+    // reads what a material of the file says once: Kd, Ks and Ns, and the first texture of each map.
+    // .obj files list normal maps as bump maps, which assimp reads as height
+    MaterialInfo processMaterial(aiMaterial *mat)
+    {
+        MaterialInfo info;
+        aiColor3D color(1.0f, 1.0f, 1.0f);
+        mat->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+        info.diffuse = glm::vec3(color.r, color.g, color.b);
+        color = aiColor3D(1.0f, 1.0f, 1.0f);
+        mat->Get(AI_MATKEY_COLOR_SPECULAR, color);
+        info.specular = glm::vec3(color.r, color.g, color.b);
+        info.shininess = 32.0f;
+        mat->Get(AI_MATKEY_SHININESS, info.shininess);
+        info.maps[MAP_DIFFUSE] = loadMaterialTexture(mat, aiTextureType_DIFFUSE, DIFFUSE);
+        info.maps[MAP_SPECULAR] = loadMaterialTexture(mat, aiTextureType_SPECULAR, SPECULAR);
+        info.maps[MAP_NORMAL] = loadMaterialTexture(mat, aiTextureType_HEIGHT, NORMAL);
+        return info;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, TexType texType)
+    // the index in textures_loaded of the material's first texture of a type, -1 when it has none; a texture
+    // is only loaded once, whatever materials share it
+    int loadMaterialTexture(aiMaterial *mat, aiTextureType type, TexType texType)
     {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        if(mat->GetTextureCount(type) == 0)
+            return -1;
+        aiString str;
+        mat->GetTexture(type, 0, &str);
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = texType;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                return j;
         }
-        return textures;
+        // DecodeTextures() and Upload() fill it in later
+        Texture texture;
+        texture.id = 0;
+        texture.layer = 0;
+        texture.type = texType;
+        texture.path = str.C_Str();
+        textures_loaded.push_back(texture);
+        DecodedImage image = { NULL, 0, 0, 0 };
+        images.push_back(image);
+        return textures_loaded.size() - 1;
     }
-};
 
+    // pixels of textures_loaded[i] between DecodeTextures() and Upload()
+    vector<DecodedImage> images;
+    TextureArrays* textureArrays;
+    MaterialLibrary* materials;
+    MaterialBatch* batch;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    Model(const Model&);
+    Model& operator=(const Model&);
+};
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        stbi_image_free(data);
-    }
-    else
+bool DecodeImage(const string &filename, DecodedImage &image)
+{
+    image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    if (!image.data)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Texture failed to load at path: " << filename << std::endl;
+        return false;
     }
-
-    return textureID;
+    return true;
 }
 #endif
 
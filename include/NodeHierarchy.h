@@ -0,0 +1,38 @@
+#ifndef NODE_HIERARCHY_H
+#define NODE_HIERARCHY_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// A node tree flattened into arrays in topological order: a node's parent always comes before it, so the
+// world matrices update in one pass from front to back, each node reading the world matrix of a parent
+// that is already done. No recursion and no pointers to follow, only a parent index per node.
+class NodeHierarchy
+{
+    public:
+        NodeHierarchy();
+
+        // parent is -1 for a root and an index added before otherwise; returns the node's index
+        unsigned int Add(int parent, const glm::mat4 &local);
+        void SetLocal(unsigned int node, const glm::mat4 &local);
+
+        // recomputes the world matrices of the nodes whose local matrix, or an ancestor's, was set since the
+        // last call; returns how many there were
+        unsigned int Update();
+        unsigned int Count() const;
+        int Parent(unsigned int node) const;
+        const glm::mat4 &Local(unsigned int node) const;
+        const glm::mat4 &World(unsigned int node) const;
+
+    private:
+        std::vector<int> parents;
+        std::vector<glm::mat4> locals;
+        std::vector<glm::mat4> worlds;
+        // set since the last Update(), or below a node that was
+        std::vector<unsigned char> changed;
+        // no node before it was set, the pass starts here
+        unsigned int firstChanged;
+};
+
+#endif // NODE_HIERARCHY_H
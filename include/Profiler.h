@@ -0,0 +1,85 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+
+struct ProfileEvent
+{
+    const char* name;           // has to outlive the profiler, string literals in practice
+    unsigned long long start;   // nanoseconds since the profiler's epoch
+    unsigned long long end;
+};
+
+// a ring of zones shown as one track in the trace, a thread's own or one made with Profiler::CreateTrack
+struct ProfileBuffer;
+
+// Frame profiler writing Chrome trace_event JSON (load it in chrome://tracing or Perfetto).
+// CPU zones are scoped with PROFILE_ZONE("name"). Each thread appends its zones to a ring of its own,
+// so recording takes no lock: two clock reads and a store. GPU zones live in GpuProfiler.h, this header
+// needs no GL. Recording is off until Enable(true), a disabled zone costs a load of a flag. Building with
+// PROFILER_DISABLED defined compiles out the zones and the PROFILE_ macros, and Enabled() is always false.
+class Profiler
+{
+    public:
+        // zones kept per thread, older ones are overwritten
+        static const unsigned int EVENTS_PER_THREAD = 1 << 16;
+        static void Enable(bool enabled);
+        static bool Enabled()
+        {
+#ifdef PROFILER_DISABLED
+            return false;
+#else
+            return enabled.load(std::memory_order_relaxed);
+#endif
+        }
+        // names the calling thread's track in the trace
+        static void SetThreadName(const char* name);
+
+        static unsigned long long Now();
+        static void Record(const char* name, unsigned long long start, unsigned long long end);
+        // a track not tied to a thread, for zones timed somewhere else; left out of ZoneCount()
+        static ProfileBuffer* CreateTrack(const char* name);
+        // only one thread may record to a track
+        static void Record(ProfileBuffer* track, const char* name, unsigned long long start, unsigned long long end);
+
+        // safe to call while other threads keep recording
+        static bool WriteChromeTrace(const char* path);
+        // zones recorded since the start, over every thread
+        static unsigned long long ZoneCount();
+        // nanoseconds one enabled zone costs, measured with zones on the calling thread
+        static double MeasureZoneCost(unsigned int zones = 100000);
+
+    private:
+        static std::atomic<bool> enabled;
+};
+
+class ProfileZone
+{
+    public:
+        ProfileZone(const char* name)
+            : name(name), start(Profiler::Enabled() ? Profiler::Now() : 0)
+        {
+        }
+        ~ProfileZone()
+        {
+            if (start)
+                Profiler::Record(name, start, Profiler::Now());
+        }
+
+    private:
+        const char* name;
+        unsigned long long start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef PROFILER_DISABLED
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD_NAME(name)
+#else
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#endif
+
+#endif // PROFILER_H
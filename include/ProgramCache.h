@@ -0,0 +1,42 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct ProgramLoad
+{
+    std::string name;
+    bool fromCache;
+    double ms;      // reading the sources plus either loading the binary or compiling and linking
+};
+
+// Linked program binaries kept on disk (glGetProgramBinary / glProgramBinary), so a launch that sees
+// the same shaders again skips compiling them. A binary is only valid for the driver that produced it,
+// so the key hashes the vendor, renderer and version strings together with the sources and defines.
+// Drivers may still reject a binary after an update, that counts as a miss and the program is
+// compiled from source and stored again. Binaries need GL 4.1; below that every load is a miss.
+class ProgramCache
+{
+    public:
+        static bool Available();
+        static std::string Key(const std::string &vertexSource, const std::string &fragmentSource, const std::string &defines);
+
+        // sets the retrievable hint on a program that is going to be linked from source
+        static void PrepareLink(unsigned int program);
+        // true when the program is linked from the cached binary
+        static bool Load(const std::string &key, unsigned int program);
+        static void Store(const std::string &key, unsigned int program);
+
+        // every program load since the start, for --shader-stats
+        static void Record(const std::string &name, bool fromCache, double ms);
+        // the startup batch: how many programs it compiled, from the first submit to the last one linked
+        static void RecordBatch(unsigned int programs, double wallMs, bool parallel);
+        static const std::vector<ProgramLoad> &Loads();
+        static void WriteStatsJson(std::ostream &out);
+};
+
+#endif // PROGRAM_CACHE_H
@@ -0,0 +1,106 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad.h>
+
+#include <string>
+#include <vector>
+
+#include "DeferredRenderer.h"
+#include "Font.h"
+#include "FramePacket.h"
+#include "GpuTimer.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "Shader.h"
+#include "ShaderPermutations.h"
+#include "ShaderWatcher.h"
+#include "TextRenderer.h"
+#include "UniformBuffer.h"
+
+class Model;
+
+const int TEXT_BENCH_LABELS = 10000;
+
+struct RendererSettings
+{
+    bool gpuTiming;         // GPU time of the scene pass, printed once per second
+    bool glStats;           // state changes and stream buffer waits, printed once per second
+    bool benchText;         // TEXT_BENCH_LABELS labels whose text changes every frame
+    bool clusterStats;      // light binning times of the clustered path, printed once per second
+    bool shaderStats;       // compile or cache load time of every program, printed once after setup
+    bool hotReload;         // shaders are rebuilt when their files in src/ are written
+    FontMode fontMode;
+};
+
+// Owns every GL object of the scene and draws frame packets. It has to be created, used and destroyed
+// on the thread the GL context is current on.
+class Renderer
+{
+    public:
+        // loads the shaders and the font, the backpack comes later through SetBackpack
+        Renderer(JobSystem &jobs, const RendererSettings &settings);
+        ~Renderer();
+
+        // ---- STARTUP ----
+        // the backpack is parsed and its images decoded on job threads while the context is made,
+        // neither touches GL. SetBackpack uploads it, takes it over and finishes the startup batch
+        static Model* ParseBackpack();
+        static void DecodeBackpack(Model* model, JobSystem &jobs);
+        void SetBackpack(Model* model);
+
+        // draws the packet into the target framebuffer, the caller swaps
+        void RenderFrame(const FramePacket &packet);
+        // frames go to this framebuffer instead of the default one, 0 switches back
+        void SetTarget(unsigned int framebuffer);
+
+    private:
+        RendererSettings settings;
+        // ahead of every shader member, so their compiles overlap; SetBackpack finishes it
+        ShaderBatch shaderBatch;
+
+        // the backpack's shaders come in one variant per material feature combination
+        ShaderPermutations basicShaders;
+        Shader lightShader;
+        ShaderPermutations clusteredShaders;
+        Font font;
+        TextRenderer text;
+        UniformBuffer frameUniforms;
+        DeferredRenderer deferred;
+        LightClusters clusters;
+        Model* backpack;
+        std::vector<unsigned int> backpackFeatures;
+        ShaderWatcher* shaderWatcher;
+        std::vector<ShaderChange> shaderChanges;
+        unsigned int cubeVAO;
+        unsigned int lightCubeVAO;
+        unsigned int cubeVBO;
+
+        int frameTimeLabel;
+        std::vector<int> benchLabels;
+        std::vector<std::string> benchStrings;
+        double benchLayoutMs;
+        double benchFlushMs;
+        int benchFrames;
+
+        GpuTimer scenePassTimer;
+        ShadingPath timedPath;
+        double clusterBinMs;
+        double clusterUploadMs;
+        unsigned int clusterFrames;
+        float lastTimingReport;
+        float lastStatsReport;
+        float lastTextReport;
+        float lastClusterReport;
+        unsigned int targetFramebuffer;
+
+        void reloadShaders();
+        void drawScene(const FramePacket &packet);
+        void drawText(const FramePacket &packet);
+        void reportClusters(const FramePacket &packet);
+
+        Renderer(const Renderer&);
+        Renderer& operator=(const Renderer&);
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,66 @@
+#ifndef SDF_GENERATOR_H
+#define SDF_GENERATOR_H
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct SdfGlyph
+{
+    unsigned int codepoint;
+    glm::ivec2 size;
+    glm::ivec2 bearing;
+    unsigned int advance;
+    std::vector<unsigned char> pixels;
+};
+
+// Produces signed distance field glyphs from the outlines of a font with FreeType's sdf renderer.
+// Glyphs are generated on worker threads, each with its own FT_Face since faces can't be shared
+// between threads. Finished glyphs are kept in a cache file next to the other caches so the next
+// run loads them instead of generating them again; the file is keyed by a hash of the font's bytes.
+// The distance is stored as 128 on the outline, increasing inwards, spread pixels to either side.
+class SdfGenerator
+{
+    public:
+        unsigned int RasterSize;
+        unsigned int Spread;
+
+        // threads = 0 uses every core but one
+        SdfGenerator(const char* fontPath, unsigned int rasterSize, unsigned int spread, unsigned int threads = 0);
+        // stops the workers and writes the cache file if anything new was generated
+        ~SdfGenerator();
+
+        // fills in the glyph and returns true when it is cached, otherwise queues it for the workers
+        bool Request(unsigned int codepoint, SdfGlyph &glyph);
+        // moves the glyphs finished since the last call into finished
+        void Collect(std::vector<SdfGlyph> &finished);
+        void SaveCache();
+
+    private:
+        std::string fontPath;
+        std::string cachePath;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<unsigned int> requests;
+        std::vector<SdfGlyph> results;
+        std::unordered_set<unsigned int> pending;
+        std::unordered_map<unsigned int, SdfGlyph> cache;
+        bool cacheDirty;
+        bool stopping;
+
+        void work();
+        void loadCache();
+
+        SdfGenerator(const SdfGenerator&);
+        SdfGenerator& operator=(const SdfGenerator&);
+};
+
+#endif // SDF_GENERATOR_H
@@ -8,12 +8,26 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <chrono>
+#include <vector>
+
+enum ReloadStatus
+{
+    RELOAD_IDLE,        // no reload was started
+    RELOAD_PENDING,     // the new program is still compiling
+    RELOAD_SWAPPED,     // ID is the new program now
+    RELOAD_FAILED       // the new sources didn't link, ID is still the old program
+};
 
 class Shader
 {
     public:
         unsigned int ID;
-        Shader(const char* vertexPath, const char* fragmentPath);
+        // #include "file" lines are pasted in place, relative to the including file. defines ("#define NAME\n"
+        // lines) are inserted after #version in both stages; linked programs come from ProgramCache when the
+        // same expanded sources were built before
+        Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines = "");
+        ~Shader();
         void Use();
         void SetBool(const std::string &name, bool value) const;
         void SetInt(const std::string &name, int value) const;
@@ -25,6 +39,82 @@ class Shader
         void SetFloat4(const std::string &name, glm::vec4 value) const;
         void SetFloat4(const std::string &name, float v1, float v2, float v3, float v4) const;
         void SetMat4(const std::string &name, const glm::mat4 &mat) const;
+
+        // ---- STARTUP BATCH ----
+        // Shaders created between BeginBatch and EndBatch only submit their compile and link, EndBatch then
+        // collects them all, so the driver can work on several programs at once. Use() before EndBatch
+        // finishes the link of its own program only, the rest stay in the batch. KHR_parallel_shader_compile
+        // gets the driver's thread count when its entry point was loaded with LoadCompilerThreads after glad.
+        static void LoadCompilerThreads(GLADloadproc loader);
+        static void BeginBatch();
+        static void EndBatch();
+        // reads every shader file of the directory into memory, needs no context so it can run on a job
+        // thread while the window is created; it has to finish before the first shader is built from it.
+        // ClearPrefetched drops the copies once startup is done, reloads read the files again
+        static void PrefetchSources(const std::string &directory);
+        static void ClearPrefetched();
+
+        // ---- HOT RELOAD ----
+        // only with KHR_parallel_shader_compile: without it the compile and the link status query would block
+        // the render thread, so there is no hot reload
+        static bool CanReload();
+        // every live shader, the render thread looks for the ones built from a changed file here
+        static const std::vector<Shader*> &All();
+        // true for the two stage files and everything they include
+        bool UsesFile(const std::string &path) const;
+        // "vertex path + fragment path [defines]", for stats
+        std::string Name() const;
+        // compiles and links the current sources into a second program without waiting on the driver,
+        // a reload still pending is dropped for the newer one
+        void BeginReload(std::chrono::steady_clock::time_point requestTime);
+        // called at the frame boundary: swaps ID to the new program once it is linked, keeping the int
+        // uniforms set on the old one; a program that fails to link is thrown away and the old one stays.
+        // A program the driver is still compiling is left for a later frame. latencyMs is the time from the
+        // request to the swap
+        ReloadStatus PollReload(double &latencyMs);
+
+    private:
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::string defines;
+        // the stage file first, then its includes in the order they were pasted
+        std::vector<std::string> vertexFiles;
+        std::vector<std::string> fragmentFiles;
+        std::string cacheKey;
+        // the stages of the program still linking, kept for their logs
+        unsigned int linkVertex;
+        unsigned int linkFragment;
+        std::chrono::steady_clock::time_point linkStart;
+        unsigned int pendingID;
+        unsigned int pendingVertex;
+        unsigned int pendingFragment;
+        std::string pendingKey;
+        std::chrono::steady_clock::time_point reloadRequest;
+
+        bool readSources(std::string &vertexString, std::string &fragmentString);
+        void submitLink(const std::string &vertexString, const std::string &fragmentString);
+        // checks the link, stores the binary and binds the uniform blocks
+        void finishLink();
+        void bindUniformBlocks();
+        void bindMaterialSamplers();
+        void copyIntUniforms(unsigned int from, unsigned int to);
+        void deletePending();
+
+        Shader(const Shader&);
+        Shader& operator=(const Shader&);
+};
+
+// Keeps a batch open from its construction to Finish(). As a member declared ahead of the shaders, every
+// shader the owner's constructor creates lands in the batch
+class ShaderBatch
+{
+    public:
+        ShaderBatch();
+        ~ShaderBatch();
+        void Finish();
+
+    private:
+        bool open;
 };
 
 #endif // SHADER_H
@@ -0,0 +1,44 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <map>
+#include <string>
+
+#include "Shader.h"
+
+// the maps a mesh's material provides, one bit per feature
+enum MaterialFeature
+{
+    MATERIAL_SPECULAR_MAP = 1 << 0,
+    MATERIAL_NORMAL_MAP = 1 << 1,
+    MATERIAL_DIFFUSE_MAP = 1 << 2
+};
+
+const unsigned int MATERIAL_FEATURE_COUNT = 3;
+// the define each feature bit turns on in the shaders, in bit order
+extern const char* const MATERIAL_FEATURE_DEFINES[MATERIAL_FEATURE_COUNT];
+
+// One pair of shader files built once per combination of material features, with the features' defines
+// set. A combination is compiled the first time it is asked for, so only the ones the loaded meshes use
+// are paid for; the programs stay here for the next frame and ProgramCache keeps their binaries for the
+// next launch. A mesh without a specular (or diffuse) map gets a program that doesn't sample one at all.
+class ShaderPermutations
+{
+    public:
+        // defines are set in every variant, before the feature defines
+        ShaderPermutations(const char* vertexPath, const char* fragmentPath, const std::string &defines = "");
+        ~ShaderPermutations();
+
+        Shader &Get(unsigned int features);
+
+    private:
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::string defines;
+        std::map<unsigned int, Shader*> variants;
+
+        ShaderPermutations(const ShaderPermutations&);
+        ShaderPermutations& operator=(const ShaderPermutations&);
+};
+
+#endif // SHADER_PERMUTATIONS_H
@@ -0,0 +1,44 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ShaderChange
+{
+    std::string path;                                   // directory + "/" + file name, as Shader paths are written
+    std::chrono::steady_clock::time_point time;         // when the watcher saw the write
+};
+
+// Watches a directory for shader files being written, with inotify on a thread of its own, and hands
+// the changes to the render thread which polls once per frame. A file written several times before the
+// next poll is reported once, with the time of the first write.
+// Only Linux has inotify, elsewhere the watcher reports nothing.
+class ShaderWatcher
+{
+    public:
+        ShaderWatcher(const char* directory);
+        ~ShaderWatcher();
+
+        // moves the changes seen since the last call into changes, never blocks
+        void Poll(std::vector<ShaderChange> &changes);
+
+    private:
+        std::string directory;
+        int fd;
+        std::thread thread;
+        std::atomic<bool> stopping;
+        std::mutex mutex;
+        std::vector<ShaderChange> pending;
+
+        void watch();
+
+        ShaderWatcher(const ShaderWatcher&);
+        ShaderWatcher& operator=(const ShaderWatcher&);
+};
+
+#endif // SHADER_WATCHER_H
@@ -0,0 +1,81 @@
+#ifndef STARTUP_GRAPH_H
+#define STARTUP_GRAPH_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "JobSystem.h"
+
+enum StartupStepKind
+{
+    STEP_CPU,   // any job thread
+    STEP_GL     // thread 0, where the context is current
+};
+
+// Startup as a graph of steps over the job system. A step is started the moment the last step it depends
+// on finishes, CPU steps on whichever job thread is free and GL steps on thread 0, so file parsing and
+// image decoding run while the context is being created and each GL step runs as soon as its inputs are.
+// Every step's span is kept for a timeline (Chrome trace_event JSON, the same format --profile writes)
+// measured from origin, normally the start of main().
+class StartupGraph
+{
+    public:
+        StartupGraph(JobSystem &jobs, std::chrono::steady_clock::time_point origin);
+        ~StartupGraph();
+
+        // name has to outlive the graph, a string literal in practice; dependencies are earlier steps' indices
+        int Add(const char* name, StartupStepKind kind, const std::function<void()> &work,
+                const std::vector<int> &dependencies = std::vector<int>());
+        // runs every step and returns once the last one finished, thread 0 only
+        void Run();
+        // a span spent outside the graph, such as the window created on the main thread; any thread
+        void Record(const char* name, const char* thread, std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end);
+        // once the first frame is on screen
+        void FirstFrame(std::chrono::steady_clock::time_point time);
+        double TimeToFirstFrameMs() const;
+
+        bool WriteTrace(const char* path) const;
+        // {"timeToFirstFrameMs":..,"steps":{"name":ms,...}}
+        void WriteStatsJson(std::ostream &out) const;
+
+    private:
+        struct Span
+        {
+            const char* name;
+            const char* thread;
+            double startMs;
+            double endMs;
+        };
+
+        struct Step
+        {
+            StartupGraph* graph;
+            const char* name;
+            StartupStepKind kind;
+            std::function<void()> work;
+            std::vector<Step*> dependents;
+            std::atomic<int> waiting;   // unfinished dependencies
+        };
+
+        JobSystem &jobs;
+        std::chrono::steady_clock::time_point origin;
+        std::vector<Step*> steps;
+        JobCounter counter;
+        mutable std::mutex mutex;
+        std::vector<Span> spans;
+        double firstFrameMs;
+
+        double sinceOrigin(std::chrono::steady_clock::time_point time) const;
+        void launch(Step* step);
+        static void execute(void* data);
+
+        StartupGraph(const StartupGraph&);
+        StartupGraph& operator=(const StartupGraph&);
+};
+
+#endif // STARTUP_GRAPH_H
@@ -0,0 +1,85 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad.h>
+
+#include <ostream>
+
+// A suballocation handed out by StreamBuffer. ptr is write-only mapped memory, offset is where
+// the data lives inside StreamBuffer::ID for glBindBufferRange, attribute pointers or indirect draws.
+// A failed allocation has a NULL ptr and an offset of -1.
+struct StreamAllocation
+{
+    void* ptr;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+struct StreamStats
+{
+    unsigned int allocations;
+    GLsizeiptr bytes;
+    // times BeginFrame() found the GPU still reading the region it was about to reuse
+    unsigned int fenceWaits;
+    double fenceWaitMs;
+    // allocations refused because the frame region was full
+    unsigned int failedAllocations;
+};
+
+// Triple-buffered ring for data rewritten every frame (uniform blocks, text quads, instance data,
+// indirect commands). Each frame writes into its own region, and a fence placed at the end of the
+// frame guards the region until the GPU is done with it.
+// On GL 4.4 the buffer is created with glBufferStorage and mapped once, persistently and coherently.
+// On 3.3 every allocation maps its range with GL_MAP_UNSYNCHRONIZED_BIT instead, which means it has to
+// be committed before the next Allocate() and before any draw that reads it.
+class StreamBuffer
+{
+    public:
+        unsigned int ID;
+
+        // owner names the ring in MemoryTracker
+        StreamBuffer(GLsizeiptr bytesPerFrame, unsigned int framesInFlight = 3, const char* owner = "stream buffer");
+        ~StreamBuffer();
+
+        // waits for the fence of the next region if needed and starts writing into it
+        void BeginFrame();
+        // fences the current region, call after the last draw that reads from it was submitted
+        void EndFrame();
+
+        // fails when the frame region has no room left, the data already handed out this frame stays untouched;
+        // the caller skips whatever would have read the allocation
+        StreamAllocation Allocate(GLsizeiptr size, GLsizeiptr alignment);
+        // makes the written data visible to GL, a no-op with persistent mapping or a failed allocation
+        void Commit(const StreamAllocation &allocation);
+        // Allocate() + memcpy + Commit(), returns the offset the data was written at or -1 when it failed
+        GLintptr Write(const void* data, GLsizeiptr size, GLsizeiptr alignment);
+
+        bool IsPersistent() const;
+        const StreamStats &LastFrame() const;
+        void WriteStatsJson(std::ostream &out) const;
+
+        // the strictest offset alignment for each kind of data this ring serves
+        static GLsizeiptr UniformAlignment();
+        static const GLsizeiptr VERTEX_ALIGNMENT = 16;
+        static const GLsizeiptr INDIRECT_ALIGNMENT = 4;
+
+    private:
+        static const unsigned int MAX_FRAMES = 4;
+
+        GLsizeiptr frameSize;
+        unsigned int frameCount;
+        unsigned int frameIndex;
+        GLsizeiptr head;
+        bool persistent;
+        unsigned char* mapped;
+        GLsync fences[MAX_FRAMES];
+        StreamStats currentFrame;
+        StreamStats lastFrame;
+        // the error is printed for the first refused allocation only, the stats keep counting them
+        bool reportedFull;
+
+        StreamBuffer(const StreamBuffer&);
+        StreamBuffer& operator=(const StreamBuffer&);
+};
+
+#endif // STREAM_BUFFER_H
@@ -0,0 +1,105 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "Font.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+
+// 20 bytes per vertex, four per glyph quad
+struct TextVertex
+{
+    glm::vec2 position;             // in pixels, origin at the bottom left of the screen
+    unsigned short texCoords[2];    // normalized u, v inside the atlas page
+    unsigned short page;
+    unsigned short pad;
+    unsigned char color[4];
+};
+
+struct TextStats
+{
+    unsigned int labels;        // Label() calls
+    unsigned int runsReused;    // labels drawn from their cached run
+    unsigned int runsLaidOut;   // labels and Text() calls laid out again this frame
+    unsigned int quads;
+    unsigned int drawCalls;
+};
+
+// Lays strings out into glyph quads and draws all the text of a frame with a single call.
+// Every quad of the frame is appended straight into the mapped region of a StreamBuffer, and Flush()
+// draws the whole region with one glDrawElements over a static quad index buffer. The atlas being a
+// texture array means glyphs on different pages don't break the batch.
+// Text() lays its string out every time. Label() keeps the laid-out run of the label, relative to its
+// origin, and only lays it out again when its string or size changes (or the font moved its glyphs),
+// so moving or recoloring a label costs no layout.
+class TextRenderer
+{
+    public:
+        TextRenderer(Font &font, unsigned int maxQuadsPerFrame = 65536);
+        ~TextRenderer();
+
+        // call after Font::BeginFrame() and before any text of the frame
+        void BeginFrame(int screenWidth, int screenHeight);
+        void Text(const std::string &text, glm::vec2 position, unsigned int pixelSize, glm::vec4 color);
+
+        int CreateLabel();
+        void ReleaseLabel(int label);
+        void Label(int label, const std::string &text, glm::vec2 position, unsigned int pixelSize, glm::vec4 color);
+
+        // uploads new glyphs and draws everything queued this frame, leaves depth testing enabled and blending disabled
+        void Flush();
+        // counters of the last flushed frame
+        const TextStats &LastFrame() const;
+
+    private:
+        // a glyph quad relative to the run's origin
+        struct RunQuad
+        {
+            glm::vec2 min;
+            glm::vec2 max;
+            unsigned short texCoords[4];    // u0, v0, u1, v1
+            unsigned short page;
+        };
+
+        struct Run
+        {
+            std::string text;
+            unsigned int pixelSize;
+            unsigned int generation;
+            bool live;
+            std::vector<RunQuad> quads;
+            std::vector<int> pages;         // atlas pages the quads sample, to keep them from being evicted
+        };
+
+        Font &font;
+        Shader shader;
+        StreamBuffer stream;
+        unsigned int VAO;
+        unsigned int EBO;
+        unsigned int maxQuads;
+        glm::vec2 screenSize;
+
+        StreamAllocation frameVertices;
+        TextVertex* cursor;
+        unsigned int quadCount;
+        bool overflowed;
+
+        std::vector<Run> runs;
+        std::vector<int> freeRuns;
+        std::vector<RunQuad> scratch;
+        TextStats currentFrame;
+        TextStats lastFrame;
+
+        void layout(const std::string &text, unsigned int pixelSize, std::vector<RunQuad> &quads, std::vector<int>* pages);
+        void emit(const RunQuad* quads, unsigned int count, glm::vec2 position, glm::vec4 color);
+
+        TextRenderer(const TextRenderer&);
+        TextRenderer& operator=(const TextRenderer&);
+};
+
+#endif // TEXT_RENDERER_H
@@ -0,0 +1,52 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <glad.h>
+
+#include <string>
+#include <vector>
+
+// where a packed image ended up, texture 0 for an image that failed to decode
+struct TextureLayer
+{
+    unsigned int texture;   // a GL_TEXTURE_2D_ARRAY
+    unsigned int layer;
+};
+
+// Packs images into GL_TEXTURE_2D_ARRAYs grouped by pixel format and size, so meshes with different maps
+// still sample the same textures and can be drawn together. Every image keeps its own size and texels:
+// nothing is resampled, and nothing is padded, which would break GL_REPEAT on UVs outside [0, 1] that the
+// models rely on. A group with more images than GL_MAX_ARRAY_TEXTURE_LAYERS takes several arrays.
+class TextureArrays
+{
+    public:
+        // owner is the asset the arrays are booked under in MemoryTracker
+        TextureArrays(const std::string &owner);
+        ~TextureArrays();
+
+        // the pixels are read by Build() and have to stay valid until then; returns the image's index
+        unsigned int Add(const unsigned char* pixels, int width, int height, int components);
+        // creates the arrays and uploads every image, GL thread only
+        void Build();
+        TextureLayer Layer(unsigned int image) const;
+        unsigned int ArrayCount() const;
+
+    private:
+        struct Image
+        {
+            const unsigned char* pixels;
+            int width;
+            int height;
+            int components;
+            TextureLayer placed;
+        };
+
+        std::string owner;
+        std::vector<Image> images;
+        std::vector<unsigned int> arrays;
+
+        TextureArrays(const TextureArrays&);
+        TextureArrays& operator=(const TextureArrays&);
+};
+
+#endif // TEXTURE_ARRAYS_H
@@ -0,0 +1,18 @@
+#ifndef TRANSFORM_MATH_H
+#define TRANSFORM_MATH_H
+
+#include <glm/glm.hpp>
+
+// A mat3 laid out the way std140 stores it: every column padded to a vec4
+struct NormalMatrix
+{
+    glm::vec4 columns[3];
+};
+
+// Fills normalMatrices[i] with the inverse transpose of the upper 3x3 of models[i].
+// Transforms made of a rotation and a uniform scale skip the inverse entirely, for them
+// the inverse transpose is the matrix itself divided by the squared scale.
+// Uses SSE when the compiler targets it and falls back to scalar code otherwise.
+void ComputeNormalMatrices(const glm::mat4 *models, NormalMatrix *normalMatrices, unsigned int count);
+
+#endif // TRANSFORM_MATH_H
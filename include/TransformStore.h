@@ -0,0 +1,52 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+#include "TransformMath.h"
+
+// The transforms of a scene in structure of arrays layout: every component of the positions, rotations and
+// scales in an array of its own, so four transforms load into one SSE register per component. A set only
+// marks the transform in a dirty bitset; Update() recomposes the world and normal matrices of the marked
+// ones, four at a time, and leaves the rest alone. The matrices sit in one contiguous array each, in the
+// order the transforms were added, ready to be copied into an instance buffer.
+class TransformStore
+{
+    public:
+        TransformStore();
+
+        // returns the transform's index, its matrices are there after the next Update(); rotation is a unit quaternion
+        unsigned int Add(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+        void SetPosition(unsigned int index, const glm::vec3 &position);
+        void SetRotation(unsigned int index, const glm::quat &rotation);
+        void SetScale(unsigned int index, const glm::vec3 &scale);
+        // marks every transform, the next Update() recomposes them all
+        void MarkAllDirty();
+
+        // recomposes the transforms set since the last call, returns how many there were
+        unsigned int Update();
+        unsigned int Count() const;
+        // Count() of each, valid until the next Add()
+        const glm::mat4* WorldMatrices() const;
+        const NormalMatrix* NormalMatrices() const;
+
+    private:
+        // the arrays are padded to a multiple of 4 with identity transforms, so a group never reads past them
+        std::vector<float> positionX, positionY, positionZ;
+        std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+        std::vector<float> scaleX, scaleY, scaleZ;
+        std::vector<glm::mat4> worlds;
+        std::vector<NormalMatrix> normals;
+        std::vector<unsigned long long> dirty;
+        unsigned int count;
+        unsigned int dirtyCount;
+
+        void markDirty(unsigned int index);
+        // recomposes the four transforms from first on, first is a multiple of 4
+        void composeFour(unsigned int first);
+};
+
+#endif // TRANSFORM_STORE_H
@@ -0,0 +1,137 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad.h>
+#include <glm/glm.hpp>
+
+#include "TransformMath.h"
+#include "StreamBuffer.h"
+
+// Binding points shared by every program. Shader binds the blocks it declares to these after linking,
+// so a block written once per frame is visible to all programs without any glUniform* calls.
+enum UniformBinding
+{
+    PER_FRAME_BINDING = 0,
+    LIGHTING_BINDING  = 1,
+    MATERIAL_BINDING  = 2,
+    OBJECT_BINDING    = 3,
+    NODES_BINDING     = 4
+};
+
+// Block names as declared in the shaders, indexed by UniformBinding
+const char* const UNIFORM_BLOCK_NAMES[] = { "PerFrame", "Lighting", "MaterialBlock", "Object", "Nodes" };
+const unsigned int UNIFORM_BLOCK_COUNT = 5;
+
+// ---- STD140 BLOCKS ----
+// These mirror the layout (std140) blocks in the shaders byte for byte. A vec3 takes 16 bytes
+// unless a float follows it, in which case the float fills the fourth component.
+
+struct PerFrameBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPos;
+    float time;
+    glm::mat4 inverseViewProjection;    // for rebuilding world positions from depth
+};
+
+// the forward path loops over every light for every fragment, so it only sees this many
+const unsigned int MAX_FORWARD_LIGHTS = 256;
+
+// also the per-instance layout of the deferred light volumes
+struct PointLight
+{
+    glm::vec3 position;
+    float radius;       // the light fades to exactly zero at this distance
+    glm::vec3 color;
+    float pad0;
+};
+
+struct LightingBlock
+{
+    glm::vec3 lightPos;
+    float pad0;
+    glm::vec3 lightColor;
+    int pointLightCount;
+    glm::vec3 ambientLight;
+    float pad1;
+    PointLight pointLights[MAX_FORWARD_LIGHTS];
+};
+
+// the materials of one model share a block, a vertex picks its material by index; as many as fit in the
+// 16KB every GL 3.3 driver allows for a block
+const unsigned int MAX_MATERIALS = 16384 / 48;
+
+struct MaterialParams
+{
+    glm::vec3 diffuse;      // Kd
+    float shininess;        // Ns
+    glm::vec3 specular;     // Ks
+    float pad0;
+    glm::uvec4 layers;      // texture array layer of each MaterialMap
+};
+
+struct MaterialBlock
+{
+    MaterialParams materials[MAX_MATERIALS];
+};
+
+struct ObjectBlock
+{
+    glm::mat4 model;
+    NormalMatrix normalMatrix;
+};
+
+// the nodes of one model that carry meshes, a vertex picks its node by index; the block stays below the
+// 16KB every GL 3.3 driver allows
+const unsigned int MAX_MESH_NODES = 128;
+
+struct NodesBlock
+{
+    ObjectBlock nodes[MAX_MESH_NODES];  // world matrix in the model and its normal matrix
+};
+
+static_assert(sizeof(PerFrameBlock) == 272, "PerFrameBlock must match the std140 PerFrame block");
+static_assert(sizeof(PointLight) == 32, "PointLight must match the std140 PointLight struct");
+static_assert(sizeof(LightingBlock) == 48 + 32 * MAX_FORWARD_LIGHTS, "LightingBlock must match the std140 Lighting block");
+static_assert(sizeof(MaterialParams) == 48, "MaterialParams must match the std140 MaterialParams struct");
+static_assert(sizeof(MaterialBlock) == 48 * MAX_MATERIALS, "MaterialBlock must match the std140 MaterialBlock block");
+static_assert(sizeof(ObjectBlock) == 112, "ObjectBlock must match the std140 Object block");
+static_assert(sizeof(NodesBlock) == 112 * MAX_MESH_NODES, "NodesBlock must match the std140 Nodes block");
+
+// Uniform blocks streamed through a StreamBuffer ring. Each frame writes into its own fenced region,
+// so a block is never overwritten while the GPU may still be reading it for an earlier frame.
+class UniformBuffer
+{
+    public:
+        unsigned int ID;
+
+        UniformBuffer(unsigned int bytesPerFrame, unsigned int framesInFlight = 3);
+        // moves on to the next region of the ring, call once at the start of every frame
+        void BeginFrame();
+        // fences the region, call once every draw of the frame has been submitted
+        void EndFrame();
+        // copies size bytes into the current region and returns the offset they were written at, -1 when the
+        // region is full
+        GLintptr Push(const void* data, GLsizeiptr size);
+        void Bind(UniformBinding binding, GLintptr offset, GLsizeiptr size) const;
+        const StreamBuffer &Stream() const;
+
+        // false when the region is full, the binding is left alone and the draws that need it are skipped
+        template<typename T>
+        bool PushBlock(UniformBinding binding, const T &block)
+        {
+            GLintptr offset = Push(&block, sizeof(T));
+            if (offset < 0)
+                return false;
+            Bind(binding, offset, sizeof(T));
+            return true;
+        }
+
+    private:
+        StreamBuffer stream;
+        GLsizeiptr alignment;
+};
+
+#endif // UNIFORM_BUFFER_H
@@ -2,8 +2,18 @@
 #define MAIN_H_INCLUDED
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <vector>
 
 #include <glad.h>
@@ -11,67 +21,84 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <ft2build.h>
-#include FT_FREETYPE_H
-
-#include "Shader.h"
 #include "Camera.h"
-#include "Model.h"
+#include "UniformBuffer.h"
+#include "TransformMath.h"
+#include "TransformStore.h"
+#include "NodeHierarchy.h"
+#include "JobSystem.h"
+#include "FrameQueue.h"
+#include "Renderer.h"
+#include "FixedTimestep.h"
+#include "GpuProfiler.h"
+#include "CameraPath.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+#include "StartupGraph.h"
+
+// point lights circle around these, somewhere inside the group of backpacks
+struct LightOrbit
+{
+    glm::vec3 center;
+    float radius;
+    float speed;
+    float phase;
+    glm::vec3 color;
+};
+
+// movement keys sampled once per frame and applied by every simulation step of that frame
+struct MoveInput
+{
+    int right;
+    int forward;
+    int up;
+    bool running;
+};
+
+// --bench run, the scene settings come from the other flags
+struct BenchOptions
+{
+    unsigned int frames;
+    const char* pathFile;       // NULL flies the default path
+    const char* outputPath;
+    double maxStartupMs;        // a slower time to first frame fails the run, 0 never does
+};
 
-void processInput(GLFWwindow *window);
+// the window main() creates, for the render thread's startup graph which waits on it
+struct WindowHandoff
+{
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool done;
+    GLFWwindow* window;         // NULL when creating it failed
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+void processInput(GLFWwindow *window, MoveInput &move);
+void renderThread(WindowHandoff* handoff, FrameQueue* frames, RendererSettings settings);
+Renderer* startUp(JobSystem &jobs, StartupGraph &graph, const RendererSettings &settings,
+                  const std::function<GLFWwindow*()> &createWindow, GLFWwindow* &window);
+void reportStartup(const StartupGraph &graph);
+void fillFramePacket(FramePacket &packet, unsigned int frameNumber, float time, float delta, const glm::vec3 &cameraPosition,
+                     float sceneTime, const std::vector<PointLight> &previousLights, const std::vector<PointLight> &currentLights,
+                     float alpha);
+int runBenchmark(const BenchOptions &options, const RendererSettings &settings, unsigned int pointLightCount);
+void createDefaultCameraPath(CameraPath &path);
+void createSceneTransforms();
+void benchmarkTransforms();
+void benchmarkHierarchy();
+void createLightOrbits(std::vector<LightOrbit> &orbits, unsigned int count);
+void updatePointLights(const std::vector<LightOrbit> &orbits, std::vector<PointLight> &lights, float time);
 void didChangeSize(GLFWwindow* window, int width, int height);
 void didChangeMousePosition(GLFWwindow* window, double xPos, double yPos);
 void didChangeScrollValue(GLFWwindow* window, double xOffset, double yOffset);
 
-float cube_vertices[] = {
-    // float3 position, float2 texCoord, float3 normal
-    // front
-    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-     0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f,
-     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f, 0.0f, -1.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
-    // back
-    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-     0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-     0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-     0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-    // left
-    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-    -0.5f,  0.5f, -0.5f,  1.0f, 1.0f, -1.0f, 0.0f, 0.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, -1.0f, 0.0f, 0.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, -1.0f, 0.0f, 0.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-    // right
-     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-     0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-     0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-    // bottom
-    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f, -1.0f, 0.0f,
-     0.5f, -0.5f, -0.5f,  1.0f, 1.0f, 0.0f, -1.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f, -1.0f, 0.0f,
-    // top
-    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f, 1.0f, 0.0f
-};
-
-glm::vec3 cubesPositions[] = {
+const int BACKPACK_COUNT = 7;
+glm::vec3 cubesPositions[BACKPACK_COUNT] = {
     glm::vec3(0.0f, 0.0f, -2.0f),
     glm::vec3(2.0f, 0.0f, -1.0f),
     glm::vec3(-2.0f, 1.0f, -2.0f),
@@ -81,10 +108,36 @@ glm::vec3 cubesPositions[] = {
     glm::vec3(-5.0f, 2.0f, -8.0f),
 };
 
+// the backpacks in cubesPositions order, then the light cube; the transforms only change when something moves them
+TransformStore sceneTransforms;
+unsigned int lightCubeTransform = 0;
+
 glm::vec3 lightCubePosition = glm::vec3(1.5f, 0.6f, 0.4f);
 glm::vec3 ambientLight = glm::vec3(0.1f, 0.4f, 0.3f);
 glm::vec3 lightColor = glm::vec3(0.9f, 0.5f, 0.4f);
 
+const char* const PROFILE_TRACE_PATH = "trace.json";
+const char* const MEMORY_STATS_PATH = "memory.json";
+const char* const STARTUP_TRACE_PATH = "startup.json";
+const unsigned int TRANSFORM_BENCH_COUNT = 100000;
+const unsigned int TRANSFORM_BENCH_DIRTY = TRANSFORM_BENCH_COUNT / 100;
+const unsigned int TRANSFORM_BENCH_ITERATIONS = 200;
+// the hierarchy benchmark hangs this many chains of this many nodes below one root
+const unsigned int HIERARCHY_BENCH_CHAINS = 100;
+const unsigned int HIERARCHY_BENCH_DEPTH = 1000;
+const unsigned int HIERARCHY_BENCH_ITERATIONS = 50;
+// the benchmark steps time by a fixed amount per frame, so every run renders the same views
+const float BENCH_FRAME_SECONDS = 1.0f / 60.0f;
+const unsigned int BENCH_WARMUP_FRAMES = 30;
+
+ShadingPath shadingPath = SHADING_FORWARD;
+bool shadingKeyDown = false;
+bool traceKeyDown = false;
+bool memoryKeyDown = false;
+// startup is timed from here, the first thing main() does
+std::chrono::steady_clock::time_point processStart;
+bool startupTrace = false;
+
 float mixValue = 0.2f;
 int SCR_WIDTH = 1280;
 int SCR_HEIGHT = 720;
@@ -98,18 +151,142 @@ Camera camera(glm::vec3(0.0f, 1.0f, 3.0f));
 float lastX = SCR_WIDTH/2.0f, lastY = SCR_HEIGHT/2.0f;
 bool isFirstMouseUpdate = true;
 
-// ---- FONTS ----
-struct Character
+int main(int argc, char** argv)
 {
-    unsigned int textureID;
-    glm::ivec2 size;
-    glm::ivec2 bearing;
-    unsigned int advance;
-};
-std::map<char, Character> characters;
+    processStart = std::chrono::steady_clock::now();
+    // --gpu-timing prints the GPU time of the model pass once per second
+    // --gl-stats prints the issued and redundant state changes, the stream buffer fence waits of the last frame and the frame queue waits once per second
+    // --sdf-font renders text from signed distance field glyphs instead of per-size bitmaps
+    // --bench-text draws TEXT_BENCH_LABELS labels whose text changes every frame and prints the layout time once per second
+    // --deferred starts on the deferred shading path, --clustered on the clustered forward one, G cycles through
+    // forward, deferred and clustered at runtime
+    // --lights N adds N moving point lights (the forward path shades at most MAX_FORWARD_LIGHTS of them)
+    // --cluster-stats prints the light binning times of the clustered path once per second
+    // --bench-transforms times the transform store updating TRANSFORM_BENCH_COUNT transforms of which 1% changed,
+    // all of them, and rebuilding them all with glm the way the scene used to, then exits
+    // --bench-hierarchy times the world matrix pass over a flattened hierarchy of HIERARCHY_BENCH_CHAINS chains
+    // HIERARCHY_BENCH_DEPTH nodes deep, with the root moved and with one node deep down moved, against a recursive
+    // walk over a tree of separately allocated nodes, then exits
+    // --frame-queue N lets the simulation run at most N frames ahead of the render thread, 1 to FrameQueue::MAX_DEPTH
+    // --sim-rate HZ runs the simulation at HZ fixed steps per second, 60 by default
+    // --max-steps N runs at most N simulation steps per frame and drops the rest of a hitch, 5 by default
+    // --sim-stats prints the simulation steps, their cost and the time dropped by the clamp once per second
+    // --profile records CPU and GPU zones, P writes them to PROFILE_TRACE_PATH as a Chrome trace and so does exiting
+    // --bench renders --bench-frames N frames (600 by default) along a camera path into an offscreen framebuffer of
+    // SCR_WIDTH x SCR_HEIGHT with a hidden window, prints frame time percentiles, draw calls, triangles and load time
+    // as JSON, writes them to --bench-out FILE as well (bench.json by default) and exits. --bench-path FILE plays back
+    // a path saved by --record-path FILE, which records the camera of an interactive run
+    // --shader-stats prints whether each program was compiled or loaded from the binary cache in cache/programs,
+    // and how long it took; the startup programs compile as one batch, its wall time is printed next to their sum
+    // --hot-reload rebuilds the programs made from a shader file in src/ when it is saved and prints how long the
+    // new program took to show up; a program that fails to build leaves the old one in place. It needs
+    // KHR_parallel_shader_compile and stays off without it
+    // M prints the live and high-water GPU and CPU memory per category and per asset, --memory-stats also writes
+    // them to MEMORY_STATS_PATH at exit; GL objects still alive after the renderer is gone are reported as leaks
+    // --startup-trace writes the startup steps to STARTUP_TRACE_PATH as a Chrome trace once the first frame is
+    // shown and prints each step's time and the time to first frame; --bench adds the same numbers to its JSON
+    // --max-startup-ms MS makes --bench fail with exit code 1 when its first frame took longer than MS from launch
+    unsigned int pointLightCount = 0;
+    unsigned int frameQueueDepth = 2;
+    double simulationRate = 60.0;
+    unsigned int maxSteps = 5;
+    bool simulationStats = false;
+    bool profile = false;
+    bool bench = false;
+    BenchOptions benchOptions;
+    benchOptions.frames = 600;
+    benchOptions.pathFile = NULL;
+    benchOptions.outputPath = "bench.json";
+    benchOptions.maxStartupMs = 0.0;
+    const char* recordPath = NULL;
+    bool memoryStats = false;
+    RendererSettings settings;
+    settings.gpuTiming = false;
+    settings.glStats = false;
+    settings.benchText = false;
+    settings.clusterStats = false;
+    settings.shaderStats = false;
+    settings.hotReload = false;
+    settings.fontMode = FONT_BITMAP;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--gpu-timing")
+            settings.gpuTiming = true;
+        else if (std::string(argv[i]) == "--gl-stats")
+            settings.glStats = true;
+        else if (std::string(argv[i]) == "--sdf-font")
+            settings.fontMode = FONT_SDF;
+        else if (std::string(argv[i]) == "--bench-text")
+            settings.benchText = true;
+        else if (std::string(argv[i]) == "--deferred")
+            shadingPath = SHADING_DEFERRED;
+        else if (std::string(argv[i]) == "--clustered")
+            shadingPath = SHADING_CLUSTERED;
+        else if (std::string(argv[i]) == "--cluster-stats")
+            settings.clusterStats = true;
+        else if (std::string(argv[i]) == "--lights" && i + 1 < argc)
+            pointLightCount = (unsigned int)atoi(argv[++i]);
+        else if (std::string(argv[i]) == "--frame-queue" && i + 1 < argc)
+            frameQueueDepth = (unsigned int)atoi(argv[++i]);
+        else if (std::string(argv[i]) == "--sim-rate" && i + 1 < argc)
+            simulationRate = atof(argv[++i]);
+        else if (std::string(argv[i]) == "--max-steps" && i + 1 < argc)
+            maxSteps = (unsigned int)atoi(argv[++i]);
+        else if (std::string(argv[i]) == "--sim-stats")
+            simulationStats = true;
+        else if (std::string(argv[i]) == "--profile")
+            profile = true;
+        else if (std::string(argv[i]) == "--bench")
+            bench = true;
+        else if (std::string(argv[i]) == "--bench-frames" && i + 1 < argc)
+            benchOptions.frames = (unsigned int)atoi(argv[++i]);
+        else if (std::string(argv[i]) == "--bench-path" && i + 1 < argc)
+            benchOptions.pathFile = argv[++i];
+        else if (std::string(argv[i]) == "--bench-out" && i + 1 < argc)
+            benchOptions.outputPath = argv[++i];
+        else if (std::string(argv[i]) == "--record-path" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (std::string(argv[i]) == "--memory-stats")
+            memoryStats = true;
+        else if (std::string(argv[i]) == "--shader-stats")
+            settings.shaderStats = true;
+        else if (std::string(argv[i]) == "--hot-reload")
+            settings.hotReload = true;
+        else if (std::string(argv[i]) == "--startup-trace")
+            startupTrace = true;
+        else if (std::string(argv[i]) == "--max-startup-ms" && i + 1 < argc)
+            benchOptions.maxStartupMs = atof(argv[++i]);
+        else if (std::string(argv[i]) == "--bench-transforms")
+        {
+            benchmarkTransforms();
+            return 0;
+        }
+        else if (std::string(argv[i]) == "--bench-hierarchy")
+        {
+            benchmarkHierarchy();
+            return 0;
+        }
+    }
+    createSceneTransforms();
 
-int main()
-{
+    Profiler::Enable(profile);
+    PROFILE_THREAD_NAME("main");
+    if (bench)
+    {
+        // an edit in the middle of a run would land in the frame times
+        settings.hotReload = false;
+        return runBenchmark(benchOptions, settings, pointLightCount);
+    }
+
+    // window events and input stay on this thread as GLFW requires, the GL context goes to the render thread.
+    // It starts first, so the files are read while the window is made
+    FrameQueue frames(frameQueueDepth);
+    WindowHandoff handoff;
+    handoff.done = false;
+    handoff.window = NULL;
+    std::thread renderer(renderThread, &handoff, &frames, settings);
+
+    std::chrono::steady_clock::time_point windowStart = std::chrono::steady_clock::now();
     glfwInit();
 
     // set OpenGL version to 3.3 core profile
@@ -123,196 +300,279 @@ int main()
 
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL)
-    {
         std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    {
+        std::lock_guard<std::mutex> lock(handoff.mutex);
+        handoff.window = window;
+        handoff.start = windowStart;
+        handoff.end = std::chrono::steady_clock::now();
+        handoff.done = true;
     }
-    glfwMakeContextCurrent(window);
-
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    handoff.ready.notify_one();
+    if (window == NULL)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+        renderer.join();
+        glfwTerminate();
         return -1;
     }
 
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-
-
     // Setup callbakcs
     glfwSetFramebufferSizeCallback(window, didChangeSize);
     glfwSetCursorPosCallback(window, didChangeMousePosition);
     glfwSetScrollCallback(window, didChangeScrollValue);
-
-    glEnable(GL_DEPTH_TEST);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    stbi_set_flip_vertically_on_load(true);
 
-    Shader basicShader("src/basic_vertex.vs", "src/basic_fragment.fs");
-    Shader lightShader("src/light_vertex.vs", "src/light_fragment.fs");
+    std::vector<LightOrbit> lightOrbits;
+    createLightOrbits(lightOrbits, pointLightCount);
+    unsigned int frameNumber = 0;
+
+    // the last two simulation states, rendering interpolates between them
+    FixedTimestep timestep(1.0 / (simulationRate > 0.0 ? simulationRate : 60.0), maxSteps);
+    double simulationTime = 0.0;
+    glm::vec3 previousCameraPosition = camera.Position;
+    std::vector<PointLight> previousLights(pointLightCount);
+    std::vector<PointLight> currentLights(pointLightCount);
+    updatePointLights(lightOrbits, currentLights, 0.0f);
+    previousLights = currentLights;
+    double simulationMs = 0.0;
+    float lastSimulationReport = 0.0f;
+    lastTime = (float)glfwGetTime();
+    float startTime = lastTime;
+    CameraPath recording;
+
+    // ---- SIMULATION LOOP ----
+    while(!glfwWindowShouldClose(window))
+    {
+        float currentTime = (float)glfwGetTime();
+        deltaTime = currentTime - lastTime;
+        lastTime = currentTime;
 
-    // ---- Free Type --- (font loading)
+        MoveInput move;
+        {
+            PROFILE_ZONE("processInput");
+            processInput(window, move);
+        }
 
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft))
-    {
-        std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-        return -1;
+        // ---- FIXED STEPS ----
+        std::chrono::steady_clock::time_point stepsStart = std::chrono::steady_clock::now();
+        unsigned int steps = timestep.Advance(deltaTime);
+        float step = (float)timestep.Step();
+        for (unsigned int i = 0; i < steps; i++)
+        {
+            PROFILE_ZONE("simulation step");
+            previousCameraPosition = camera.Position;
+            previousLights.swap(currentLights);
+
+            camera.ProcessMovement(move.right, move.forward, move.up, move.running, step);
+            simulationTime += step;
+            updatePointLights(lightOrbits, currentLights, (float)simulationTime);
+        }
+        simulationMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepsStart).count();
+        if (simulationStats && currentTime - lastSimulationReport >= 1.0f)
+        {
+            const TimestepStats &stats = timestep.Stats();
+            std::cout << "{\"frames\":" << stats.frames
+                      << ",\"steps\":" << stats.steps
+                      << ",\"simulationMs\":" << simulationMs
+                      << ",\"clampedFrames\":" << stats.clampedFrames
+                      << ",\"droppedMs\":" << stats.droppedSeconds * 1000.0 << "}" << std::endl;
+            timestep.ResetStats();
+            simulationMs = 0.0;
+            lastSimulationReport = currentTime;
+        }
+        // mouse look is applied as it comes in, only the stepped state is interpolated
+        float alpha = timestep.Alpha();
+        glm::vec3 cameraPosition = glm::mix(previousCameraPosition, camera.Position, alpha);
+        if (recordPath)
+        {
+            CameraKey key;
+            key.time = currentTime - startTime;
+            key.position = cameraPosition;
+            key.yaw = camera.Yaw;
+            key.pitch = camera.Pitch;
+            recording.Add(key);
+        }
+
+        // blocks while the render thread is frameQueueDepth frames behind
+        FramePacket* packet;
+        {
+            PROFILE_ZONE("wait for render thread");
+            packet = frames.BeginWrite();
+        }
+        if (packet == NULL)
+            break;
+        // runs until the next frame, glfwPollEvents shows nested at its end
+        PROFILE_ZONE("frame packet");
+        fillFramePacket(*packet, frameNumber, currentTime, deltaTime, cameraPosition,
+                        (float)(simulationTime - (1.0f - alpha) * step), previousLights, currentLights, alpha);
+
+        frames.EndWrite();
+        {
+            PROFILE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
+        frameNumber++;
     }
 
-    FT_Face face;
-    if (FT_New_Face(ft, "./fonts/NotoMono-Regular.ttf", 0, &face))
+    // the render thread finishes the packets already queued and frees the GL objects with its context
+    frames.Close();
+    renderer.join();
+    if (memoryStats)
     {
-        std::cout << "ERROR::FREETYPE: failed to load font" << std::endl;
-        return -1;
+        // the renderer is gone, live is what leaked and highWater is the peak of the run
+        std::ofstream out(MEMORY_STATS_PATH);
+        MemoryTracker::WriteJson(out);
+        out << std::endl;
     }
-
-    FT_Set_Pixel_Sizes(face, 0, 48);
-    if (FT_Load_Char(face, 'X', FT_LOAD_RENDER))
+    if (recordPath && recording.Save(recordPath))
+        std::cout << "camera path written to " << recordPath << std::endl;
+    if (profile && Profiler::Enabled())
     {
-        std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-        return -1;
+        // zones per frame times the cost of one, against the average frame
+        Profiler::WriteChromeTrace(PROFILE_TRACE_PATH);
+        unsigned long long zones = Profiler::ZoneCount();
+        double frameNs = frameNumber > 0 ? ((float)glfwGetTime() - startTime) * 1e9 / frameNumber : 0.0;
+        double zonesPerFrame = frameNumber > 0 ? (double)zones / frameNumber : 0.0;
+        double zoneNs = Profiler::MeasureZoneCost();
+        std::cout << "{\"frames\":" << frameNumber
+                  << ",\"zones\":" << zones
+                  << ",\"zonesPerFrame\":" << zonesPerFrame
+                  << ",\"nsPerZone\":" << zoneNs
+                  << ",\"overheadPercent\":" << (frameNs > 0.0 ? 100.0 * zonesPerFrame * zoneNs / frameNs : 0.0) << "}" << std::endl;
     }
+    glfwTerminate();
+    return 0;
+}
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    for (unsigned char c = 0; c < 128; c++)
+// ---- STARTUP ----
+
+// Builds the renderer through the startup graph on the calling thread, which becomes the GL thread. The shader
+// files, the model and its images are read on job threads while createWindow runs, the GL steps follow as soon
+// as their inputs are there. Returns NULL when there is no window or no context.
+Renderer* startUp(JobSystem &jobs, StartupGraph &graph, const RendererSettings &settings,
+                  const std::function<GLFWwindow*()> &createWindow, GLFWwindow* &window)
+{
+    Renderer* renderer = NULL;
+    Model* model = NULL;
+    bool contextReady = false;
+    int sources = graph.Add("read shader sources", STEP_CPU, []() { Shader::PrefetchSources("src"); });
+    int parse = graph.Add("parse model", STEP_CPU, [&model]() { model = Renderer::ParseBackpack(); });
+    int decode = graph.Add("decode textures", STEP_CPU, [&model, &jobs]() { Renderer::DecodeBackpack(model, jobs); }, { parse });
+    int context = graph.Add("make context current", STEP_GL, [&]()
     {
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+        window = createWindow();
+        if (window == NULL)
+            return;
+        glfwMakeContextCurrent(window);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
         {
-            std::cout << "ERROR::FREETYPE: Failed to load glyph" << std::endl;
-            continue;
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return;
         }
-
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            face->glyph->advance.x
-        };
-        characters.insert(std::pair<char, Character>(c, character));
-    }
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
-
-    // ---- SETUP ONCE ----
-
-    unsigned int cubeVAO;
-    glGenVertexArrays(1, &cubeVAO);
-    glBindVertexArray(cubeVAO);
-
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    unsigned int lightCubeVAO;
-    glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);
-
-    glBindVertexArray(0);
-
-    Model ourModel("assets/backpack/backpack.obj");
-
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    // ---- RENDER LOOP ----
-    while(!glfwWindowShouldClose(window))
+        Shader::LoadCompilerThreads((GLADloadproc)glfwGetProcAddress);
+        PROFILE_GPU_INIT();
+        contextReady = true;
+    });
+    int setup = graph.Add("renderer setup", STEP_GL, [&]()
     {
-        float currentTime = (float)glfwGetTime();
-        deltaTime = currentTime - lastTime;
-        lastTime = currentTime;
-
-        processInput(window);
-
-        glClearColor(ambientLight.x, ambientLight.y, ambientLight.z, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (contextReady)
+            renderer = new Renderer(jobs, settings);
+    }, { context, sources });
+    graph.Add("upload model", STEP_GL, [&]()
+    {
+        // without a context the model goes with the process, its destructor would call GL
+        if (renderer)
+            renderer->SetBackpack(model);
+    }, { setup, decode });
+    graph.Run();
+    // later variants and reloads read the files as they are then
+    Shader::ClearPrefetched();
+    return renderer;
+}
 
-        basicShader.Use();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        basicShader.SetMat4("projection", projection);
-        basicShader.SetMat4("view", view);
+void reportStartup(const StartupGraph &graph)
+{
+    if (graph.WriteTrace(STARTUP_TRACE_PATH))
+        std::cout << "startup trace written to " << STARTUP_TRACE_PATH << std::endl;
+    graph.WriteStatsJson(std::cout);
+    std::cout << std::endl;
+}
 
-        basicShader.SetFloat("time", (float)glfwGetTime());
-        basicShader.SetFloat3("cameraPos", camera.Position);
-        basicShader.SetFloat3("lightColor", lightColor);
-        basicShader.SetFloat3("lightPos", lightCubePosition);
-        basicShader.SetFloat3("material.ambient", ambientLight);
-        basicShader.SetFloat3("material.color", 1.0f, 1.0f, 1.0f);
-        basicShader.SetFloat("material.shininess", 128.0f);
+// ---- RENDER THREAD ----
 
-        // DRAW MODELS
-        for (int i = 0; i < 7; i++)
+void renderThread(WindowHandoff* handoff, FrameQueue* frames, RendererSettings settings)
+{
+    PROFILE_THREAD_NAME("render");
+    // this thread owns the GL context, so it is thread 0 of the job system and runs its GL jobs
+    JobSystem jobs;
+    StartupGraph graph(jobs, processStart);
+    GLFWwindow* window = NULL;
+    Renderer* renderer = startUp(jobs, graph, settings, [handoff, &graph]() -> GLFWwindow*
+    {
+        std::unique_lock<std::mutex> lock(handoff->mutex);
+        handoff->ready.wait(lock, [handoff]() { return handoff->done; });
+        graph.Record("create window", "main", handoff->start, handoff->end);
+        return handoff->window;
+    }, window);
+    if (renderer == NULL)
+    {
+        frames->Close();
+        if (window)
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubesPositions[i]);
-            model = glm::rotate(model, cos((float)i * 4.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::rotate(model, cos((float)i * 20.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.3f, 0.3f, 0.3f));
-
-            basicShader.SetMat4("model", model);
-            ourModel.Draw(basicShader);
+            glfwSetWindowShouldClose(window, true);
+            glfwMakeContextCurrent(NULL);
         }
-
-        // DRAW LIGHT CUBE
-        //lightCubePosition.x = sin((float)glfwGetTime()) * 10.0f;
-        //lightCubePosition.z = -4.0f + cos((float)glfwGetTime()) * 10.0f;
-        lightShader.Use();
-        glm::mat4 lightModel = glm::mat4(1.0f);
-        lightModel = glm::translate(lightModel, lightCubePosition);
-        lightModel = glm::scale(lightModel, glm::vec3(0.2f));
-        lightShader.SetMat4("model", lightModel);
-        lightShader.SetMat4("view", view);
-        lightShader.SetMat4("projection", projection);
-        lightShader.SetFloat3("color", lightColor);
-
-        glBindVertexArray(lightCubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        // END RENDERING
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        return;
     }
 
-    glfwTerminate();
-    return 0;
+    {
+        bool firstFrame = true;
+        float lastQueueReport = 0.0f;
+        while (true)
+        {
+            FramePacket* packet;
+            {
+                PROFILE_ZONE("wait for frame packet");
+                packet = frames->BeginRead();
+            }
+            if (packet == NULL)
+                break;
+
+            // GL work handed over by jobs since the last frame
+            jobs.PumpMainThread();
+            renderer->RenderFrame(*packet);
+            float time = packet->time;
+            // everything in the packet has been copied into GL buffers, the simulation can reuse it
+            frames->EndRead();
+
+            if (settings.glStats && time - lastQueueReport >= 1.0f)
+            {
+                std::cout << "{\"frameQueue\":";
+                frames->WriteStatsJson(std::cout);
+                std::cout << "}" << std::endl;
+                lastQueueReport = time;
+            }
+            {
+                PROFILE_ZONE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+            PROFILE_GPU_COLLECT();
+            if (firstFrame)
+            {
+                graph.FirstFrame(std::chrono::steady_clock::now());
+                if (startupTrace)
+                    reportStartup(graph);
+                firstFrame = false;
+            }
+        }
+    }
+    delete renderer;
+    PROFILE_GPU_SHUTDOWN();
+    MemoryTracker::ReportLeaks(std::cout);
+    glfwMakeContextCurrent(NULL);
 }
 
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, MoveInput &move)
 {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -337,14 +597,484 @@ void processInput(GLFWwindow *window)
         running = true;
 
 
-    camera.ProcessMovement(rMove, fMove, uMove, running, deltaTime);
+    move.right = rMove;
+    move.forward = fMove;
+    move.up = uMove;
+    move.running = running;
+
+    // switch on the press only, not on every frame the key is held
+    bool shadingKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (shadingKey && !shadingKeyDown)
+    {
+        shadingPath = (ShadingPath)((shadingPath + 1) % SHADING_PATH_COUNT);
+        std::cout << SHADING_PATH_NAMES[shadingPath] << " shading" << std::endl;
+    }
+    shadingKeyDown = shadingKey;
+
+    bool traceKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (traceKey && !traceKeyDown && Profiler::Enabled())
+    {
+        if (Profiler::WriteChromeTrace(PROFILE_TRACE_PATH))
+            std::cout << "profile written to " << PROFILE_TRACE_PATH << std::endl;
+    }
+    traceKeyDown = traceKey;
+
+    bool memoryKey = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (memoryKey && !memoryKeyDown)
+    {
+        MemoryTracker::WriteJson(std::cout);
+        std::cout << std::endl;
+    }
+    memoryKeyDown = memoryKey;
+}
+
+// ---- FRAME PACKET ----
+
+// everything the render thread needs to draw one frame, lights are interpolated between the last two steps
+void fillFramePacket(FramePacket &packet, unsigned int frameNumber, float time, float delta, const glm::vec3 &cameraPosition,
+                     float sceneTime, const std::vector<PointLight> &previousLights, const std::vector<PointLight> &currentLights,
+                     float alpha)
+{
+    packet.frameNumber = frameNumber;
+    packet.time = time;
+    packet.deltaTime = delta;
+    packet.screenWidth = SCR_WIDTH;
+    packet.screenHeight = SCR_HEIGHT;
+    packet.shadingPath = shadingPath;
+
+    PerFrameBlock &perFrame = packet.perFrame;
+    perFrame.projection = glm::perspective(glm::radians(camera.Fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    perFrame.view = camera.GetViewMatrix(cameraPosition);
+    perFrame.viewProjection = perFrame.projection * perFrame.view;
+    perFrame.inverseViewProjection = glm::inverse(perFrame.viewProjection);
+    perFrame.cameraPos = cameraPosition;
+    perFrame.time = sceneTime;
+
+    packet.ambientLight = ambientLight;
+    packet.lightPos = lightCubePosition;
+    packet.lightColor = lightColor;
+    packet.pointLights = currentLights;
+    for (unsigned int i = 0; i < currentLights.size(); i++)
+        packet.pointLights[i].position = glm::mix(previousLights[i].position, currentLights[i].position, alpha);
+
+    // LIGHT CUBE
+    //lightCubePosition.x = sin((float)glfwGetTime()) * 10.0f;
+    //lightCubePosition.z = -4.0f + cos((float)glfwGetTime()) * 10.0f;
+
+    // MODELS, only the transforms set since the last packet are recomposed
+    sceneTransforms.Update();
+    const glm::mat4* models = sceneTransforms.WorldMatrices();
+    const NormalMatrix* normalMatrices = sceneTransforms.NormalMatrices();
+    packet.draws.resize(BACKPACK_COUNT + 1);
+    for (int i = 0; i <= BACKPACK_COUNT; i++)
+    {
+        packet.draws[i].mesh = i < BACKPACK_COUNT ? MESH_BACKPACK : MESH_LIGHT_CUBE;
+        packet.draws[i].object.model = models[i];
+        packet.draws[i].object.normalMatrix = normalMatrices[i];
+    }
+}
+
+static glm::quat backpackRotation(int i)
+{
+    return glm::angleAxis(cos((float)i * 4.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+           glm::angleAxis(cos((float)i * 20.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+void createSceneTransforms()
+{
+    for (int i = 0; i < BACKPACK_COUNT; i++)
+        sceneTransforms.Add(cubesPositions[i], backpackRotation(i), glm::vec3(0.3f));
+    lightCubeTransform = sceneTransforms.Add(lightCubePosition, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.2f));
+}
+
+// ---- OFFSCREEN BENCHMARK ----
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    // nearest rank
+    unsigned int rank = (unsigned int)ceil(p / 100.0 * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Renders on this thread with no render thread and no frame queue, so a frame's time is its CPU submission
+// plus a glFinish for the GPU work. The window stays hidden and the frames go to a framebuffer object of a
+// fixed size. A display is still needed for GLFW, on a machine without a GPU run it under Xvfb, Mesa falls
+// back to llvmpipe.
+int runBenchmark(const BenchOptions &options, const RendererSettings &settings, unsigned int pointLightCount)
+{
+    CameraPath path;
+    if (options.pathFile == NULL)
+        createDefaultCameraPath(path);
+    else if (!path.Load(options.pathFile))
+        return -1;
+
+    // the hidden window is made on this thread, the startup graph runs here too
+    JobSystem jobs;
+    StartupGraph graph(jobs, processStart);
+    GLFWwindow* window = NULL;
+    double contextMs = 0.0;
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    Renderer* renderer = startUp(jobs, graph, settings, [&contextMs]() -> GLFWwindow*
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL bench", NULL, NULL);
+        if (window == NULL)
+            std::cout << "Failed to create GLFW window" << std::endl;
+        contextMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return window;
+    }, window);
+    if (renderer == NULL)
+    {
+        glfwTerminate();
+        return -1;
+    }
+    glFinish();
+    // everything up to a drawable scene, the reads overlap the context so this is the whole startup graph
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+    // a hidden window's default framebuffer may have no pixels behind it, so frames go to one of our own
+    unsigned int FBO, colorRBO, depthRBO;
+    glGenFramebuffers(1, &FBO);
+    glGenRenderbuffers(1, &colorRBO);
+    glGenRenderbuffers(1, &depthRBO);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT);
+    MemoryTracker::Track(KIND_RENDERBUFFER, colorRBO, MEMORY_RENDER_TARGET, MemoryTracker::TextureBytes(GL_RGBA8, SCR_WIDTH, SCR_HEIGHT), "bench target");
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
+    MemoryTracker::Track(KIND_RENDERBUFFER, depthRBO, MEMORY_RENDER_TARGET, MemoryTracker::TextureBytes(GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT), "bench target");
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::BENCH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+
+    std::vector<double> frameMs;
+    unsigned long long drawCalls = 0;
+    unsigned long long triangles = 0;
+    {
+        renderer->SetTarget(FBO);
+
+        std::vector<LightOrbit> lightOrbits;
+        createLightOrbits(lightOrbits, pointLightCount);
+        std::vector<PointLight> lights(pointLightCount);
+        FramePacket packet;
+        for (unsigned int frame = 0; frame < BENCH_WARMUP_FRAMES + options.frames; frame++)
+        {
+            float time = frame * BENCH_FRAME_SECONDS;
+            CameraKey key = path.Sample(time);
+            camera.Position = key.position;
+            camera.SetOrientation(key.yaw, key.pitch);
+            updatePointLights(lightOrbits, lights, time);
+            fillFramePacket(packet, frame, time, BENCH_FRAME_SECONDS, key.position, time, lights, lights, 1.0f);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            jobs.PumpMainThread();
+            renderer->RenderFrame(packet);
+            glFinish();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            PROFILE_GPU_COLLECT();
+            if (frame == 0)
+                graph.FirstFrame(std::chrono::steady_clock::now());
+
+            // the first frames pay for shader compiles in the driver and first touches of the buffers
+            if (frame < BENCH_WARMUP_FRAMES)
+                continue;
+            frameMs.push_back(ms);
+            drawCalls += GLState::LastFrame().drawCalls;
+            triangles += GLState::LastFrame().triangles;
+        }
+        delete renderer;
+    }
+
+    std::ostringstream json;
+    double totalMs = 0.0;
+    for (unsigned int i = 0; i < frameMs.size(); i++)
+        totalMs += frameMs[i];
+    unsigned int frames = frameMs.size() > 0 ? frameMs.size() : 1;
+    std::sort(frameMs.begin(), frameMs.end());
+    json << "{\"renderer\":\"" << (const char*)glGetString(GL_RENDERER) << "\""
+         << ",\"width\":" << SCR_WIDTH
+         << ",\"height\":" << SCR_HEIGHT
+         << ",\"shadingPath\":\"" << SHADING_PATH_NAMES[shadingPath] << "\""
+         << ",\"lights\":" << pointLightCount
+         << ",\"path\":\"" << (options.pathFile ? options.pathFile : "default") << "\""
+         << ",\"frames\":" << frameMs.size()
+         << ",\"contextMs\":" << contextMs
+         << ",\"loadMs\":" << loadMs
+         << ",\"timeToFirstFrameMs\":" << graph.TimeToFirstFrameMs()
+         << ",\"frameMs\":{\"mean\":" << totalMs / frames
+         << ",\"p50\":" << percentile(frameMs, 50.0)
+         << ",\"p95\":" << percentile(frameMs, 95.0)
+         << ",\"p99\":" << percentile(frameMs, 99.0)
+         << ",\"max\":" << (frameMs.empty() ? 0.0 : frameMs.back()) << "}"
+         << ",\"drawCalls\":" << (double)drawCalls / frames
+         << ",\"triangles\":" << (double)triangles / frames
+         << ",\"gpuMemoryHighWater\":" << MemoryTracker::Gpu().highWater
+         << ",\"cpuMemoryHighWater\":" << MemoryTracker::Cpu().highWater
+         << ",\"startup\":";
+    graph.WriteStatsJson(json);
+    json << "}";
+    std::cout << json.str() << std::endl;
+    std::ofstream out(options.outputPath);
+    if (out)
+        out << json.str() << std::endl;
+    else
+        std::cout << "ERROR::BENCH::FILE_NOT_WRITTEN " << options.outputPath << std::endl;
+
+    if (Profiler::Enabled())
+        Profiler::WriteChromeTrace(PROFILE_TRACE_PATH);
+    if (startupTrace && graph.WriteTrace(STARTUP_TRACE_PATH))
+        std::cout << "startup trace written to " << STARTUP_TRACE_PATH << std::endl;
+    PROFILE_GPU_SHUTDOWN();
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    MemoryTracker::Release(KIND_RENDERBUFFER, colorRBO);
+    MemoryTracker::Release(KIND_RENDERBUFFER, depthRBO);
+    glDeleteRenderbuffers(1, &colorRBO);
+    glDeleteRenderbuffers(1, &depthRBO);
+    MemoryTracker::ReportLeaks(std::cout);
+    glfwMakeContextCurrent(NULL);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    // the CI gate on startup time
+    if (options.maxStartupMs > 0.0 && graph.TimeToFirstFrameMs() > options.maxStartupMs)
+    {
+        std::cout << "ERROR::BENCH::STARTUP_TOO_SLOW " << graph.TimeToFirstFrameMs() << " ms, at most "
+                  << options.maxStartupMs << " ms allowed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// one loop around the backpacks, looking at the middle of the group
+void createDefaultCameraPath(CameraPath &path)
+{
+    const int keys = 16;
+    const float seconds = 10.0f;
+    glm::vec3 center(-0.5f, -0.5f, -5.0f);
+    for (int i = 0; i <= keys; i++)
+    {
+        float angle = 6.2832f * i / keys;
+        glm::vec3 position = center + glm::vec3(sin(angle) * 9.0f, 1.5f + sin(angle * 2.0f), cos(angle) * 9.0f);
+        path.AddLookAt(seconds * i / keys, position, center);
+    }
+}
+
+// ---- POINT LIGHTS ----
+
+static float randomRange(float min, float max)
+{
+    return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+void createLightOrbits(std::vector<LightOrbit> &orbits, unsigned int count)
+{
+    // a fixed seed so forward and deferred runs light the same scene
+    srand(1);
+    orbits.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        LightOrbit &orbit = orbits[i];
+        orbit.center = glm::vec3(randomRange(-6.0f, 5.0f), randomRange(-5.0f, 4.0f), randomRange(-13.0f, 0.0f));
+        orbit.radius = randomRange(0.5f, 2.0f);
+        orbit.speed = randomRange(0.2f, 1.0f);
+        orbit.phase = randomRange(0.0f, 6.2832f);
+        orbit.color = glm::vec3(randomRange(0.2f, 1.0f), randomRange(0.2f, 1.0f), randomRange(0.2f, 1.0f));
+    }
+}
+
+void updatePointLights(const std::vector<LightOrbit> &orbits, std::vector<PointLight> &lights, float time)
+{
+    for (unsigned int i = 0; i < orbits.size(); i++)
+    {
+        const LightOrbit &orbit = orbits[i];
+        float angle = orbit.phase + time * orbit.speed;
+        lights[i].position = orbit.center + glm::vec3(cos(angle), 0.0f, sin(angle)) * orbit.radius;
+        lights[i].radius = 2.5f;
+        lights[i].color = orbit.color;
+        lights[i].pad0 = 0.0f;
+    }
+}
+
+// ---- TRANSFORM BENCHMARK ----
+
+// one JSON line: a store update with 1% of the transforms set, with all of them set, and the glm rebuild of
+// every model matrix and its normal matrix that the scene did every frame before the store
+void benchmarkTransforms()
+{
+    // a fixed seed so runs set the same transforms
+    srand(1);
+    TransformStore store;
+    std::vector<glm::vec3> positions(TRANSFORM_BENCH_COUNT);
+    for (unsigned int i = 0; i < TRANSFORM_BENCH_COUNT; i++)
+    {
+        positions[i] = glm::vec3(randomRange(-50.0f, 50.0f), randomRange(-50.0f, 50.0f), randomRange(-50.0f, 50.0f));
+        store.Add(positions[i], backpackRotation(i), glm::vec3(randomRange(0.1f, 2.0f)));
+    }
+    store.Update();
+
+    // which transforms move is picked ahead, rand() would land in the timing
+    std::vector<unsigned int> moved(TRANSFORM_BENCH_DIRTY * TRANSFORM_BENCH_ITERATIONS);
+    for (unsigned int i = 0; i < moved.size(); i++)
+        moved[i] = (unsigned int)rand() % TRANSFORM_BENCH_COUNT;
+
+    unsigned int updated = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < TRANSFORM_BENCH_ITERATIONS; iteration++)
+    {
+        const unsigned int* indices = &moved[iteration * TRANSFORM_BENCH_DIRTY];
+        for (unsigned int i = 0; i < TRANSFORM_BENCH_DIRTY; i++)
+            store.SetPosition(indices[i], positions[indices[i]] + glm::vec3((float)iteration * 0.01f));
+        updated += store.Update();
+    }
+    double dirtyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < TRANSFORM_BENCH_ITERATIONS; iteration++)
+    {
+        store.MarkAllDirty();
+        store.Update();
+    }
+    double allMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<glm::mat4> models(TRANSFORM_BENCH_COUNT);
+    std::vector<NormalMatrix> normalMatrices(TRANSFORM_BENCH_COUNT);
+    start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < TRANSFORM_BENCH_ITERATIONS; iteration++)
+    {
+        for (unsigned int i = 0; i < TRANSFORM_BENCH_COUNT; i++)
+        {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, positions[i]);
+            model = glm::rotate(model, cos((float)i * 4.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::rotate(model, cos((float)i * 20.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.3f));
+            models[i] = model;
+        }
+        ComputeNormalMatrices(&models[0], &normalMatrices[0], TRANSFORM_BENCH_COUNT);
+    }
+    double rebuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "{\"transforms\":" << TRANSFORM_BENCH_COUNT
+              << ",\"dirtyPerUpdate\":" << (double)updated / TRANSFORM_BENCH_ITERATIONS
+              << ",\"dirtyUpdateMs\":" << dirtyMs / TRANSFORM_BENCH_ITERATIONS
+              << ",\"allUpdateMs\":" << allMs / TRANSFORM_BENCH_ITERATIONS
+              << ",\"glmRebuildMs\":" << rebuildMs / TRANSFORM_BENCH_ITERATIONS
+              << ",\"checksum\":" << store.WorldMatrices()[TRANSFORM_BENCH_COUNT - 1][3][0] + models[TRANSFORM_BENCH_COUNT - 1][3][0]
+              << "}" << std::endl;
+}
+
+// ---- HIERARCHY BENCHMARK ----
+
+// a node tree the way aiNode keeps one, every node allocated on its own
+struct TreeNode
+{
+    glm::mat4 local;
+    glm::mat4 world;
+    std::vector<TreeNode*> children;
+};
+
+static void updateTree(TreeNode* node, const glm::mat4 &parentWorld)
+{
+    node->world = parentWorld * node->local;
+    for (unsigned int i = 0; i < node->children.size(); i++)
+        updateTree(node->children[i], node->world);
+}
+
+static void deleteTree(TreeNode* node)
+{
+    for (unsigned int i = 0; i < node->children.size(); i++)
+        deleteTree(node->children[i]);
+    delete node;
+}
+
+// one JSON line: the flattened pass with every node changed, with one chain's deepest tenth changed, and the
+// recursive walk, which always visits every node
+void benchmarkHierarchy()
+{
+    glm::mat4 step = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.01f, 0.0f)), 0.001f, glm::vec3(0.0f, 0.0f, 1.0f));
+    NodeHierarchy hierarchy;
+    TreeNode* root = new TreeNode();
+    root->local = glm::mat4(1.0f);
+    hierarchy.Add(-1, root->local);
+    unsigned int movedNode = 0;
+    for (unsigned int chain = 0; chain < HIERARCHY_BENCH_CHAINS; chain++)
+    {
+        int parent = 0;
+        TreeNode* parentNode = root;
+        for (unsigned int depth = 0; depth < HIERARCHY_BENCH_DEPTH; depth++)
+        {
+            parent = hierarchy.Add(parent, step);
+            TreeNode* node = new TreeNode();
+            node->local = step;
+            parentNode->children.push_back(node);
+            parentNode = node;
+            if (chain == HIERARCHY_BENCH_CHAINS / 2 && depth == HIERARCHY_BENCH_DEPTH * 9 / 10)
+                movedNode = parent;
+        }
+    }
+    hierarchy.Update();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned int allUpdated = 0;
+    for (unsigned int iteration = 0; iteration < HIERARCHY_BENCH_ITERATIONS; iteration++)
+    {
+        hierarchy.SetLocal(0, glm::translate(glm::mat4(1.0f), glm::vec3((float)iteration * 0.01f, 0.0f, 0.0f)));
+        allUpdated = hierarchy.Update();
+    }
+    double allMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    unsigned int subtreeUpdated = 0;
+    for (unsigned int iteration = 0; iteration < HIERARCHY_BENCH_ITERATIONS; iteration++)
+    {
+        hierarchy.SetLocal(movedNode, glm::rotate(step, (float)iteration * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f)));
+        subtreeUpdated = hierarchy.Update();
+    }
+    double subtreeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int iteration = 0; iteration < HIERARCHY_BENCH_ITERATIONS; iteration++)
+    {
+        root->local = glm::translate(glm::mat4(1.0f), glm::vec3((float)iteration * 0.01f, 0.0f, 0.0f));
+        updateTree(root, glm::mat4(1.0f));
+    }
+    double recursiveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    TreeNode* last = root->children.back();
+    while (!last->children.empty())
+        last = last->children.back();
+
+    std::cout << "{\"nodes\":" << hierarchy.Count()
+              << ",\"depth\":" << HIERARCHY_BENCH_DEPTH
+              << ",\"allUpdated\":" << allUpdated
+              << ",\"allMs\":" << allMs / HIERARCHY_BENCH_ITERATIONS
+              << ",\"subtreeUpdated\":" << subtreeUpdated
+              << ",\"subtreeMs\":" << subtreeMs / HIERARCHY_BENCH_ITERATIONS
+              << ",\"recursiveMs\":" << recursiveMs / HIERARCHY_BENCH_ITERATIONS
+              << ",\"checksum\":" << hierarchy.World(hierarchy.Count() - 1)[3][1] + last->world[3][1]
+              << "}" << std::endl;
+    deleteTree(root);
 }
 
 // ---- GLFW CALLBACKS ----
 
+// the viewport follows the packet size on the render thread
 void didChangeSize(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    SCR_WIDTH = width;
+    SCR_HEIGHT = height;
 }
 
 void didChangeMousePosition(GLFWwindow* window, double xPos, double yPos)
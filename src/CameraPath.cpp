@@ -0,0 +1,99 @@
+#include "CameraPath.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+void CameraPath::Add(const CameraKey &key)
+{
+    keys.push_back(key);
+}
+
+void CameraPath::AddLookAt(float time, const glm::vec3 &position, const glm::vec3 &target)
+{
+    glm::vec3 front = glm::normalize(target - position);
+    CameraKey key;
+    key.time = time;
+    key.position = position;
+    key.yaw = glm::degrees(atan2f(front.z, front.x));
+    key.pitch = glm::degrees(asinf(front.y));
+    // atan2 wraps at 180, keep the yaw continuous so the interpolation takes the short way round
+    if (!keys.empty())
+    {
+        while (key.yaw - keys.back().yaw > 180.0f)
+            key.yaw -= 360.0f;
+        while (key.yaw - keys.back().yaw < -180.0f)
+            key.yaw += 360.0f;
+    }
+    keys.push_back(key);
+}
+
+bool CameraPath::Load(const char* path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cout << "ERROR::CAMERA_PATH::FILE_NOT_READ " << path << std::endl;
+        return false;
+    }
+    keys.clear();
+    CameraKey key;
+    while (in >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+        keys.push_back(key);
+    if (keys.empty())
+    {
+        std::cout << "ERROR::CAMERA_PATH::NO_KEYS " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CameraPath::Save(const char* path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cout << "ERROR::CAMERA_PATH::FILE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+    for (unsigned int i = 0; i < keys.size(); i++)
+    {
+        const CameraKey &key = keys[i];
+        out << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z
+            << " " << key.yaw << " " << key.pitch << "\n";
+    }
+    return true;
+}
+
+bool CameraPath::Empty() const
+{
+    return keys.empty();
+}
+
+float CameraPath::Duration() const
+{
+    return keys.empty() ? 0.0f : keys.back().time - keys.front().time;
+}
+
+CameraKey CameraPath::Sample(float time) const
+{
+    if (keys.size() < 2 || Duration() <= 0.0f)
+        return keys.empty() ? CameraKey() : keys.front();
+
+    float t = keys.front().time + fmodf(time, Duration());
+    // the first key after t, paths are short enough for a linear search
+    unsigned int next = 1;
+    while (next < keys.size() - 1 && keys[next].time < t)
+        next++;
+    const CameraKey &a = keys[next - 1];
+    const CameraKey &b = keys[next];
+    float span = b.time - a.time;
+    float alpha = span > 0.0f ? (t - a.time) / span : 0.0f;
+
+    CameraKey key;
+    key.time = t;
+    key.position = glm::mix(a.position, b.position, alpha);
+    key.yaw = a.yaw + (b.yaw - a.yaw) * alpha;
+    key.pitch = a.pitch + (b.pitch - a.pitch) * alpha;
+    return key;
+}
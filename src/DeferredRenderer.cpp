@@ -0,0 +1,236 @@
+#include "DeferredRenderer.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// tessellation of the light volume, coarse is fine since it only has to bound the light
+const unsigned int SPHERE_RINGS = 8;
+const unsigned int SPHERE_SEGMENTS = 12;
+
+// texture units the G-buffer is read from during the lighting pass
+const unsigned int ALBEDO_SPECULAR_UNIT = 0;
+const unsigned int NORMAL_UNIT = 1;
+const unsigned int DEPTH_UNIT = 2;
+
+DeferredRenderer::DeferredRenderer(unsigned int maxLights)
+    : geometryShaders("src/basic_vertex.vs", "src/gbuffer_fragment.fs"),
+      ambientShader("src/fullscreen_vertex.vs", "src/deferred_ambient_fragment.fs"),
+      lightShader("src/deferred_light_vertex.vs", "src/deferred_light_fragment.fs"),
+      lightInstances(maxLights * sizeof(PointLight), 3, "deferred light instances"), maxLights(maxLights),
+      FBO(0), albedoSpecular(0), normal(0), depth(0), width(0), height(0)
+{
+    Shader* lightingShaders[] = { &ambientShader, &lightShader };
+    for (int i = 0; i < 2; i++)
+    {
+        lightingShaders[i]->Use();
+        lightingShaders[i]->SetInt("gAlbedoSpecular", ALBEDO_SPECULAR_UNIT);
+        lightingShaders[i]->SetInt("gNormal", NORMAL_UNIT);
+        lightingShaders[i]->SetInt("gDepth", DEPTH_UNIT);
+    }
+
+    // the full screen triangle has no attributes but core profile still wants a VAO bound
+    glGenVertexArrays(1, &emptyVAO);
+    createSphere();
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+    destroyTargets();
+    GLState::ForgetVertexArray(emptyVAO);
+    GLState::ForgetVertexArray(sphereVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteVertexArrays(1, &sphereVAO);
+    GLState::ForgetBuffer(sphereVBO);
+    GLState::ForgetBuffer(sphereEBO);
+    MemoryTracker::Release(KIND_BUFFER, sphereVBO);
+    MemoryTracker::Release(KIND_BUFFER, sphereEBO);
+    glDeleteBuffers(1, &sphereVBO);
+    glDeleteBuffers(1, &sphereEBO);
+}
+
+void DeferredRenderer::BeginGeometry(int width, int height)
+{
+    if (width != this->width || height != this->height)
+    {
+        destroyTargets();
+        this->width = width;
+        this->height = height;
+        createTargets();
+    }
+
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, FBO);
+    GLState::Viewport(0, 0, width, height);
+    GLState::Enable(GL_DEPTH_TEST);
+    GLState::DepthFunc(GL_LESS);
+    GLState::DepthMask(true);
+    GLState::Disable(GL_BLEND);
+    // color is only read where depth says something was drawn, clearing it would be wasted bandwidth
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+ShaderPermutations &DeferredRenderer::GeometryShaders()
+{
+    return geometryShaders;
+}
+
+void DeferredRenderer::Light(const PointLight* lights, unsigned int count, unsigned int targetFramebuffer)
+{
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    GLState::BindTexture(ALBEDO_SPECULAR_UNIT, GL_TEXTURE_2D, albedoSpecular);
+    GLState::BindTexture(NORMAL_UNIT, GL_TEXTURE_2D, normal);
+    GLState::BindTexture(DEPTH_UNIT, GL_TEXTURE_2D, depth);
+
+    // ambient and scene light, writing the G-buffer depth into the default framebuffer on the way
+    GLState::Enable(GL_DEPTH_TEST);
+    GLState::DepthFunc(GL_ALWAYS);
+    GLState::DepthMask(true);
+    GLState::Disable(GL_BLEND);
+    GLState::Disable(GL_CULL_FACE);
+    ambientShader.Use();
+    GLState::BindVertexArray(emptyVAO);
+    GLState::DrawArrays(GL_TRIANGLES, 0, 3);
+
+    if (count > maxLights)
+    {
+        std::cout << "ERROR::DEFERRED::TOO_MANY_LIGHTS " << count << std::endl;
+        count = maxLights;
+    }
+    if (count > 0)
+    {
+        lightInstances.BeginFrame();
+        GLintptr offset = lightInstances.Write(lights, count * sizeof(PointLight), StreamBuffer::VERTEX_ALIGNMENT);
+
+        // back faces that are behind or on the surface: the surface is in front of the far side of the volume
+        GLState::DepthFunc(GL_GEQUAL);
+        GLState::DepthMask(false);
+        GLState::Enable(GL_BLEND);
+        GLState::BlendFunc(GL_ONE, GL_ONE);
+        GLState::Enable(GL_CULL_FACE);
+        GLState::CullFace(GL_FRONT);
+
+        lightShader.Use();
+        GLState::BindVertexArray(sphereVAO);
+        GLState::BindBuffer(GL_ARRAY_BUFFER, lightInstances.ID);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)(offset + offsetof(PointLight, position)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)(offset + offsetof(PointLight, color)));
+        GLState::DrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0, count);
+
+        lightInstances.EndFrame();
+    }
+
+    // back to what the forward passes expect
+    GLState::DepthFunc(GL_LESS);
+    GLState::DepthMask(true);
+    GLState::Disable(GL_BLEND);
+    GLState::Disable(GL_CULL_FACE);
+    GLState::CullFace(GL_BACK);
+}
+
+void DeferredRenderer::createTargets()
+{
+    glGenFramebuffers(1, &FBO);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    unsigned int* textures[] = { &albedoSpecular, &normal, &depth };
+    GLenum internalFormats[] = { GL_RGBA8, GL_RGB10_A2, GL_DEPTH_COMPONENT24 };
+    GLenum formats[] = { GL_RGBA, GL_RGBA, GL_DEPTH_COMPONENT };
+    GLenum types[] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_INT_2_10_10_10_REV, GL_UNSIGNED_INT };
+    GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_DEPTH_ATTACHMENT };
+    for (int i = 0; i < 3; i++)
+    {
+        glGenTextures(1, textures[i]);
+        GLState::BindTexture(0, GL_TEXTURE_2D, *textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], NULL);
+        MemoryTracker::Track(KIND_TEXTURE, *textures[i], MEMORY_RENDER_TARGET,
+                             MemoryTracker::TextureBytes(internalFormats[i], width, height), "G-buffer");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[i], GL_TEXTURE_2D, *textures[i], 0);
+    }
+
+    GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::DEFERRED::GBUFFER_INCOMPLETE" << std::endl;
+}
+
+void DeferredRenderer::destroyTargets()
+{
+    if (!FBO)
+        return;
+
+    // deleting a bound framebuffer rebinds 0 behind the state cache's back
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    unsigned int textures[] = { albedoSpecular, normal, depth };
+    for (int i = 0; i < 3; i++)
+    {
+        GLState::ForgetTexture(textures[i]);
+        MemoryTracker::Release(KIND_TEXTURE, textures[i]);
+    }
+    glDeleteTextures(3, textures);
+    FBO = 0;
+}
+
+void DeferredRenderer::createSphere()
+{
+    // the flat faces of a tessellated sphere cut inside the round one, push the vertices out so the
+    // volume always contains the whole light
+    float inflate = 1.0f / (cos((float)M_PI / (2 * SPHERE_RINGS)) * cos((float)M_PI / SPHERE_SEGMENTS));
+
+    std::vector<float> vertices;
+    for (unsigned int ring = 0; ring <= SPHERE_RINGS; ring++)
+    {
+        float theta = (float)M_PI * ring / SPHERE_RINGS;
+        for (unsigned int segment = 0; segment <= SPHERE_SEGMENTS; segment++)
+        {
+            float phi = 2.0f * (float)M_PI * segment / SPHERE_SEGMENTS;
+            vertices.push_back(sin(theta) * cos(phi) * inflate);
+            vertices.push_back(cos(theta) * inflate);
+            vertices.push_back(sin(theta) * sin(phi) * inflate);
+        }
+    }
+
+    // counter-clockwise seen from outside
+    std::vector<unsigned int> indices;
+    for (unsigned int ring = 0; ring < SPHERE_RINGS; ring++)
+    {
+        for (unsigned int segment = 0; segment < SPHERE_SEGMENTS; segment++)
+        {
+            unsigned int a = ring * (SPHERE_SEGMENTS + 1) + segment;
+            unsigned int b = a + SPHERE_SEGMENTS + 1;
+            indices.push_back(a);
+            indices.push_back(a + 1);
+            indices.push_back(b);
+            indices.push_back(b);
+            indices.push_back(a + 1);
+            indices.push_back(b + 1);
+        }
+    }
+    sphereIndexCount = indices.size();
+
+    glGenVertexArrays(1, &sphereVAO);
+    glGenBuffers(1, &sphereVBO);
+    glGenBuffers(1, &sphereEBO);
+    GLState::BindVertexArray(sphereVAO);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, sphereVBO, MEMORY_GEOMETRY, vertices.size() * sizeof(float), "deferred light sphere");
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, sphereEBO, MEMORY_GEOMETRY, indices.size() * sizeof(unsigned int), "deferred light sphere");
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    // the per light attributes are pointed at the instance ring every frame
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+}
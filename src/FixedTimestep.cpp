@@ -0,0 +1,53 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(double stepSeconds, unsigned int maxSteps)
+    : step(stepSeconds), maxSteps(maxSteps < 1 ? 1 : maxSteps), accumulator(0.0)
+{
+    ResetStats();
+}
+
+unsigned int FixedTimestep::Advance(double frameSeconds)
+{
+    if (frameSeconds < 0.0)
+        frameSeconds = 0.0;
+    accumulator += frameSeconds;
+
+    unsigned int steps = (unsigned int)(accumulator / step);
+    if (steps > maxSteps)
+    {
+        // keep less than a step so the interpolation still has a fraction to work with
+        double kept = accumulator - steps * step;
+        stats.clampedFrames++;
+        stats.droppedSeconds += (steps - maxSteps) * step;
+        steps = maxSteps;
+        accumulator = kept + steps * step;
+    }
+    accumulator -= steps * step;
+
+    stats.frames++;
+    stats.steps += steps;
+    return steps;
+}
+
+double FixedTimestep::Step() const
+{
+    return step;
+}
+
+float FixedTimestep::Alpha() const
+{
+    return (float)(accumulator / step);
+}
+
+const TimestepStats &FixedTimestep::Stats() const
+{
+    return stats;
+}
+
+void FixedTimestep::ResetStats()
+{
+    stats.frames = 0;
+    stats.steps = 0;
+    stats.clampedFrames = 0;
+    stats.droppedSeconds = 0.0;
+}
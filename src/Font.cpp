@@ -0,0 +1,330 @@
+#include "Font.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+// side of one atlas page, a page holds roughly 150 glyphs at 48 px
+const int FONT_PAGE_SIZE = 512;
+
+static unsigned long long glyphKey(unsigned int codepoint, unsigned int pixelSize)
+{
+    return ((unsigned long long)pixelSize << 32) | codepoint;
+}
+
+static int pageCount(unsigned int budgetBytes)
+{
+    int pages = (int)(budgetBytes / (FONT_PAGE_SIZE * FONT_PAGE_SIZE));
+    return pages > 0 ? pages : 1;
+}
+
+Font::Font(const char* path, FontMode mode, unsigned int budgetBytes)
+    : Mode(mode), library(NULL), face(NULL), faceSize(0), sdf(NULL), atlas(FONT_PAGE_SIZE, FONT_PAGE_SIZE, pageCount(budgetBytes)),
+      frame(1), exhaustedFrame(0), generation(0), openPage(-1), pagesUsed(0), lastSize(-1)
+{
+    PROFILE_ZONE("Font load");
+    pageLastUsed.assign(atlas.Pages, 0);
+    pageSlots.resize(atlas.Pages);
+    memset(&stats, 0, sizeof(stats));
+
+    if (FT_Init_FreeType(&library))
+    {
+        std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+        library = NULL;
+        return;
+    }
+
+    // the face stays open for the lifetime of the font so any glyph can be rasterized later
+    if (FT_New_Face(library, path, 0, &face))
+    {
+        std::cout << "ERROR::FREETYPE: failed to load font" << std::endl;
+        face = NULL;
+        return;
+    }
+
+    if (Mode == FONT_SDF)
+        sdf = new SdfGenerator(path, SDF_RASTER_SIZE, SDF_SPREAD);
+}
+
+Font::~Font()
+{
+    delete sdf;
+    if (face)
+        FT_Done_Face(face);
+    if (library)
+        FT_Done_FreeType(library);
+}
+
+Glyph Font::GetGlyph(unsigned int codepoint, unsigned int pixelSize)
+{
+    pixelSize = RasterSize(pixelSize);
+    int slot = *findSlot(codepoint, pixelSize);
+    if (slot < 0)
+    {
+        Glyph glyph;
+        slot = rasterize(codepoint, pixelSize, glyph);
+        if (slot < 0)
+            return glyph;
+        *findSlot(codepoint, pixelSize) = slot;
+    }
+
+    const Glyph &glyph = glyphs[slot].glyph;
+    if (glyph.page >= 0)
+        pageLastUsed[glyph.page] = frame;
+    return glyph;
+}
+
+unsigned int Font::RasterSize(unsigned int pixelSize) const
+{
+    return Mode == FONT_SDF ? SDF_RASTER_SIZE : pixelSize;
+}
+
+void Font::BeginFrame()
+{
+    frame++;
+}
+
+void Font::Upload()
+{
+    if (sdf)
+    {
+        std::vector<SdfGlyph> finished;
+        sdf->Collect(finished);
+        for (unsigned int i = 0; i < finished.size(); i++)
+        {
+            SdfGlyph &generated = finished[i];
+            pendingAdvances.erase(generated.codepoint);
+            Glyph glyph;
+            glyph.size = generated.size;
+            glyph.bearing = generated.bearing;
+            glyph.advance = generated.advance;
+            int slot = store(generated.codepoint, SDF_RASTER_SIZE, glyph, generated.pixels.empty() ? NULL : &generated.pixels[0]);
+            if (slot >= 0)
+                *findSlot(generated.codepoint, SDF_RASTER_SIZE) = slot;
+        }
+        if (!finished.empty())
+            generation++;
+    }
+    atlas.Upload();
+}
+
+unsigned int Font::TextureID() const
+{
+    return atlas.TextureID;
+}
+
+const FontStats &Font::Stats() const
+{
+    return stats;
+}
+
+unsigned int Font::Generation() const
+{
+    return generation;
+}
+
+void Font::Touch(int page)
+{
+    if (page >= 0)
+        pageLastUsed[page] = frame;
+}
+
+// returns the lookup entry for the glyph, creating an empty (-1) one if there is none
+int* Font::findSlot(unsigned int codepoint, unsigned int pixelSize)
+{
+    if (codepoint < FONT_ASCII_GLYPHS)
+    {
+        // text is almost always drawn at a handful of sizes, usually the same one as the last lookup
+        if (lastSize < 0 || sizes[lastSize].pixelSize != pixelSize)
+        {
+            lastSize = -1;
+            for (unsigned int i = 0; i < sizes.size(); i++)
+            {
+                if (sizes[i].pixelSize == pixelSize)
+                {
+                    lastSize = i;
+                    break;
+                }
+            }
+            if (lastSize < 0)
+            {
+                SizeTable table;
+                table.pixelSize = pixelSize;
+                for (unsigned int c = 0; c < FONT_ASCII_GLYPHS; c++)
+                    table.ascii[c] = -1;
+                sizes.push_back(table);
+                lastSize = sizes.size() - 1;
+            }
+        }
+        return &sizes[lastSize].ascii[codepoint];
+    }
+
+    std::unordered_map<unsigned long long, int>::iterator it = others.find(glyphKey(codepoint, pixelSize));
+    if (it == others.end())
+        it = others.insert(std::make_pair(glyphKey(codepoint, pixelSize), -1)).first;
+    return &it->second;
+}
+
+int Font::rasterize(unsigned int codepoint, unsigned int pixelSize, Glyph &glyph)
+{
+    glyph.size = glm::ivec2(0);
+    glyph.bearing = glm::ivec2(0);
+    glyph.advance = 0;
+    glyph.uv = glm::vec4(0.0f);
+    glyph.page = -1;
+
+    if (face && faceSize != pixelSize)
+    {
+        FT_Set_Pixel_Sizes(face, 0, pixelSize);
+        faceSize = pixelSize;
+    }
+
+    if (sdf)
+    {
+        SdfGlyph generated;
+        if (sdf->Request(codepoint, generated))
+        {
+            glyph.size = generated.size;
+            glyph.bearing = generated.bearing;
+            glyph.advance = generated.advance;
+            return store(codepoint, pixelSize, glyph, generated.pixels.empty() ? NULL : &generated.pixels[0]);
+        }
+
+        // still being generated: the advance is enough to lay text out until the pixels arrive
+        std::unordered_map<unsigned int, unsigned int>::iterator pendingAdvance = pendingAdvances.find(codepoint);
+        if (pendingAdvance == pendingAdvances.end())
+        {
+            unsigned int advance = 0;
+            if (face && !FT_Load_Char(face, codepoint, FT_LOAD_DEFAULT))
+                advance = (unsigned int)face->glyph->advance.x;
+            pendingAdvance = pendingAdvances.insert(std::make_pair(codepoint, advance)).first;
+        }
+        glyph.advance = pendingAdvance->second;
+        return -1;
+    }
+
+    // a glyph that fails to load is cached without pixels so it isn't retried every frame
+    if (!face || FT_Load_Char(face, codepoint, FT_LOAD_RENDER))
+    {
+        if (face)
+            std::cout << "ERROR::FREETYPE: Failed to load glyph " << codepoint << std::endl;
+        return store(codepoint, pixelSize, glyph, NULL);
+    }
+
+    FT_Bitmap &bitmap = face->glyph->bitmap;
+    glyph.size = glm::ivec2(bitmap.width, bitmap.rows);
+    glyph.bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+    glyph.advance = (unsigned int)face->glyph->advance.x;
+
+    // FreeType rows may be padded, copy them one by one into a tight bitmap
+    std::vector<unsigned char> tight(bitmap.width * bitmap.rows);
+    for (unsigned int row = 0; row < bitmap.rows; row++)
+        memcpy(&tight[row * bitmap.width], bitmap.buffer + row * bitmap.pitch, bitmap.width);
+    return store(codepoint, pixelSize, glyph, tight.empty() ? NULL : &tight[0]);
+}
+
+// packs the glyph's pixels (if it has any) and gives it a slot, returns -1 when no page has room this frame
+int Font::store(unsigned int codepoint, unsigned int pixelSize, Glyph &glyph, const unsigned char* pixels)
+{
+    glyph.uv = glm::vec4(0.0f);
+    glyph.page = -1;
+
+    // whitespace has metrics but no pixels
+    if (pixels && glyph.size.x > 0 && glyph.size.y > 0)
+    {
+        glm::ivec2 origin;
+        int page = allocatePage(glyph.size.x, glyph.size.y, origin);
+        if (page < 0)
+            return -1;
+
+        atlas.Write(page, origin, glyph.size.x, glyph.size.y, pixels);
+        glyph.page = page;
+        glyph.uv = glm::vec4((float)origin.x / atlas.Width,
+                             (float)origin.y / atlas.Height,
+                             (float)(origin.x + glyph.size.x) / atlas.Width,
+                             (float)(origin.y + glyph.size.y) / atlas.Height);
+    }
+
+    int slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = glyphs.size();
+        glyphs.push_back(CachedGlyph());
+    }
+    glyphs[slot].glyph = glyph;
+    glyphs[slot].codepoint = codepoint;
+    glyphs[slot].pixelSize = pixelSize;
+    if (glyph.page >= 0)
+        pageSlots[glyph.page].push_back(slot);
+
+    stats.rasterized++;
+    stats.cachedGlyphs = glyphs.size() - freeSlots.size();
+    return slot;
+}
+
+int Font::allocatePage(int w, int h, glm::ivec2 &origin)
+{
+    if (openPage >= 0 && atlas.Pack(openPage, w, h, origin))
+        return openPage;
+
+    int page = -1;
+    if (pagesUsed < atlas.Pages)
+    {
+        page = pagesUsed++;
+        stats.pagesInUse = pagesUsed;
+    }
+    else
+    {
+        // least recently used page that nothing drawn this frame depends on
+        for (int i = 0; i < atlas.Pages; i++)
+        {
+            if (pageLastUsed[i] < frame && (page < 0 || pageLastUsed[i] < pageLastUsed[page]))
+                page = i;
+        }
+        if (page < 0)
+        {
+            if (exhaustedFrame != frame)
+                std::cout << "ERROR::FONT: glyph cache budget exhausted this frame" << std::endl;
+            exhaustedFrame = frame;
+            return -1;
+        }
+        evictPage(page);
+    }
+
+    openPage = page;
+    pageLastUsed[page] = frame;
+    if (!atlas.Pack(page, w, h, origin))
+    {
+        std::cout << "ERROR::FONT: glyph larger than an atlas page" << std::endl;
+        return -1;
+    }
+    return page;
+}
+
+void Font::evictPage(int page)
+{
+    std::vector<int> &slots = pageSlots[page];
+    for (unsigned int i = 0; i < slots.size(); i++)
+    {
+        CachedGlyph &cached = glyphs[slots[i]];
+        if (cached.codepoint < FONT_ASCII_GLYPHS)
+            *findSlot(cached.codepoint, cached.pixelSize) = -1;
+        else
+            others.erase(glyphKey(cached.codepoint, cached.pixelSize));
+        freeSlots.push_back(slots[i]);
+    }
+    slots.clear();
+    atlas.Clear(page);
+
+    generation++;
+    stats.evictions++;
+    stats.cachedGlyphs = glyphs.size() - freeSlots.size();
+}
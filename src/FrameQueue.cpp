@@ -0,0 +1,103 @@
+#include "FrameQueue.h"
+
+#include <thread>
+
+// checks before a waiting side goes to sleep, a frame is long compared to a yield
+const unsigned int FRAME_QUEUE_SPINS = 16;
+
+FrameQueue::FrameQueue(unsigned int maxDepth)
+    : maxDepth(maxDepth < 1 ? 1 : maxDepth > MAX_DEPTH ? MAX_DEPTH : maxDepth),
+      written(0), released(0), readCursor(0), closed(false), sleeping(0), producerWaits(0), consumerWaits(0)
+{
+}
+
+FramePacket* FrameQueue::BeginWrite()
+{
+    unsigned long long next = written.load(std::memory_order_relaxed);
+    if (next - released.load(std::memory_order_acquire) >= maxDepth)
+    {
+        producerWaits++;
+        waitUntil([this, next] { return next - released.load(std::memory_order_acquire) < maxDepth; });
+    }
+    if (closed.load(std::memory_order_acquire))
+        return NULL;
+    return &packets[next % maxDepth];
+}
+
+void FrameQueue::EndWrite()
+{
+    // seq_cst so the store can't be reordered after wakeOther()'s load of sleeping
+    written.store(written.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    wakeOther();
+}
+
+FramePacket* FrameQueue::BeginRead()
+{
+    if (written.load(std::memory_order_acquire) == readCursor)
+    {
+        consumerWaits++;
+        waitUntil([this] { return written.load(std::memory_order_acquire) != readCursor; });
+    }
+    // packets published before the close are still rendered
+    if (written.load(std::memory_order_acquire) == readCursor)
+        return NULL;
+    return &packets[readCursor % maxDepth];
+}
+
+void FrameQueue::EndRead()
+{
+    readCursor++;
+    released.store(readCursor, std::memory_order_seq_cst);
+    wakeOther();
+}
+
+void FrameQueue::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    changed.notify_all();
+}
+
+unsigned int FrameQueue::MaxDepth() const
+{
+    return maxDepth;
+}
+
+void FrameQueue::WriteStatsJson(std::ostream &out) const
+{
+    out << "{\"maxDepth\":" << maxDepth
+        << ",\"queued\":" << written.load() - released.load()
+        << ",\"producerWaits\":" << producerWaits.load()
+        << ",\"consumerWaits\":" << consumerWaits.load() << "}";
+}
+
+template <typename Ready>
+void FrameQueue::waitUntil(Ready ready)
+{
+    for (unsigned int i = 0; i < FRAME_QUEUE_SPINS; i++)
+    {
+        if (ready() || closed.load(std::memory_order_acquire))
+            return;
+        std::this_thread::yield();
+    }
+
+    sleeping.fetch_add(1, std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this, &ready] { return ready() || closed.load(); });
+    }
+    sleeping.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void FrameQueue::wakeOther()
+{
+    // the counter was stored before this check, so a side that is about to sleep either sees the new
+    // value in its predicate or is already counted here
+    if (sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        { std::lock_guard<std::mutex> lock(mutex); }
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,435 @@
+#include "GLState.h"
+
+#include <cstring>
+
+// sentinel for "not known", never equal to a real GL name or enum
+const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+enum BufferSlot
+{
+    SLOT_ARRAY,
+    SLOT_ELEMENT_ARRAY,
+    SLOT_UNIFORM,
+    SLOT_TEXTURE,
+    SLOT_DRAW_INDIRECT,
+    SLOT_PIXEL_UNPACK,
+    SLOT_COPY_READ,
+    SLOT_COPY_WRITE,
+    BUFFER_SLOT_COUNT
+};
+
+enum TextureSlot
+{
+    TEX_2D,
+    TEX_2D_ARRAY,
+    TEX_CUBE_MAP,
+    TEX_BUFFER,
+    TEXTURE_SLOT_COUNT
+};
+
+enum CapabilitySlot
+{
+    CAP_DEPTH_TEST,
+    CAP_BLEND,
+    CAP_CULL_FACE,
+    CAP_SCISSOR_TEST,
+    CAPABILITY_SLOT_COUNT
+};
+
+struct BufferRange
+{
+    unsigned int buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+struct ShadowState
+{
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int textures[GL_STATE_TEXTURE_UNITS][TEXTURE_SLOT_COUNT];
+    unsigned int samplers[GL_STATE_TEXTURE_UNITS];
+    unsigned int buffers[BUFFER_SLOT_COUNT];
+    BufferRange uniformRanges[GL_STATE_BUFFER_BINDINGS];
+    unsigned int drawFramebuffer;
+    unsigned int readFramebuffer;
+    unsigned int capabilities[CAPABILITY_SLOT_COUNT];
+    unsigned int depthFunc;
+    unsigned int depthMask;
+    unsigned int blendSrc;
+    unsigned int blendDst;
+    int viewport[4];
+    unsigned int cullFace;
+};
+
+static ShadowState state;
+static bool stateKnown = false;
+static GLStateStats currentFrame;
+static GLStateStats lastFrame;
+
+static void reset()
+{
+    memset(&state, 0xFF, sizeof(state));
+    stateKnown = true;
+}
+
+// returns true when the call has to reach the driver, counting it either way
+static bool changes(StateCall call, bool differs)
+{
+    if (!stateKnown)
+        reset();
+    if (differs)
+        currentFrame.issued[call]++;
+    else
+        currentFrame.redundant[call]++;
+    return differs;
+}
+
+static int bufferSlot(GLenum target)
+{
+    switch (target)
+    {
+        case GL_ARRAY_BUFFER:         return SLOT_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER: return SLOT_ELEMENT_ARRAY;
+        case GL_UNIFORM_BUFFER:       return SLOT_UNIFORM;
+        case GL_TEXTURE_BUFFER:       return SLOT_TEXTURE;
+        case GL_DRAW_INDIRECT_BUFFER: return SLOT_DRAW_INDIRECT;
+        case GL_PIXEL_UNPACK_BUFFER:  return SLOT_PIXEL_UNPACK;
+        case GL_COPY_READ_BUFFER:     return SLOT_COPY_READ;
+        case GL_COPY_WRITE_BUFFER:    return SLOT_COPY_WRITE;
+        default:                      return -1;
+    }
+}
+
+static int textureSlot(GLenum target)
+{
+    switch (target)
+    {
+        case GL_TEXTURE_2D:       return TEX_2D;
+        case GL_TEXTURE_2D_ARRAY: return TEX_2D_ARRAY;
+        case GL_TEXTURE_CUBE_MAP: return TEX_CUBE_MAP;
+        case GL_TEXTURE_BUFFER:   return TEX_BUFFER;
+        default:                  return -1;
+    }
+}
+
+static int capabilitySlot(GLenum capability)
+{
+    switch (capability)
+    {
+        case GL_DEPTH_TEST:   return CAP_DEPTH_TEST;
+        case GL_BLEND:        return CAP_BLEND;
+        case GL_CULL_FACE:    return CAP_CULL_FACE;
+        case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+        default:              return -1;
+    }
+}
+
+void GLState::UseProgram(unsigned int program)
+{
+    if (changes(CALL_PROGRAM, state.program != program))
+    {
+        glUseProgram(program);
+        state.program = program;
+    }
+}
+
+void GLState::BindVertexArray(unsigned int vao)
+{
+    if (changes(CALL_VERTEX_ARRAY, state.vertexArray != vao))
+    {
+        glBindVertexArray(vao);
+        state.vertexArray = vao;
+        // the element array binding belongs to the VAO
+        state.buffers[SLOT_ELEMENT_ARRAY] = UNKNOWN;
+    }
+}
+
+void GLState::ActiveTexture(unsigned int unit)
+{
+    if (changes(CALL_ACTIVE_TEXTURE, state.activeUnit != unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        state.activeUnit = unit;
+    }
+}
+
+void GLState::BindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+    int slot = textureSlot(target);
+    if (slot < 0 || unit >= GL_STATE_TEXTURE_UNITS)
+    {
+        changes(CALL_TEXTURE, true);
+        ActiveTexture(unit);
+        glBindTexture(target, texture);
+        return;
+    }
+
+    if (changes(CALL_TEXTURE, state.textures[unit][slot] != texture))
+    {
+        ActiveTexture(unit);
+        glBindTexture(target, texture);
+        state.textures[unit][slot] = texture;
+    }
+}
+
+void GLState::BindSampler(unsigned int unit, unsigned int sampler)
+{
+    if (unit >= GL_STATE_TEXTURE_UNITS)
+    {
+        changes(CALL_SAMPLER, true);
+        glBindSampler(unit, sampler);
+        return;
+    }
+
+    // names the unit itself, the active unit stays as it is
+    if (changes(CALL_SAMPLER, state.samplers[unit] != sampler))
+    {
+        glBindSampler(unit, sampler);
+        state.samplers[unit] = sampler;
+    }
+}
+
+void GLState::BindBuffer(GLenum target, unsigned int buffer)
+{
+    int slot = bufferSlot(target);
+    if (slot < 0)
+    {
+        changes(CALL_BUFFER, true);
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    if (changes(CALL_BUFFER, state.buffers[slot] != buffer))
+    {
+        glBindBuffer(target, buffer);
+        state.buffers[slot] = buffer;
+    }
+}
+
+void GLState::BindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size)
+{
+    if (target != GL_UNIFORM_BUFFER || index >= GL_STATE_BUFFER_BINDINGS)
+    {
+        changes(CALL_BUFFER_RANGE, true);
+        glBindBufferRange(target, index, buffer, offset, size);
+        return;
+    }
+
+    BufferRange &range = state.uniformRanges[index];
+    if (changes(CALL_BUFFER_RANGE, range.buffer != buffer || range.offset != offset || range.size != size))
+    {
+        glBindBufferRange(target, index, buffer, offset, size);
+        range.buffer = buffer;
+        range.offset = offset;
+        range.size = size;
+        // binding a range also binds the generic target
+        state.buffers[SLOT_UNIFORM] = buffer;
+    }
+}
+
+void GLState::BindFramebuffer(GLenum target, unsigned int framebuffer)
+{
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool differs = (draw && state.drawFramebuffer != framebuffer) || (read && state.readFramebuffer != framebuffer);
+    if (changes(CALL_FRAMEBUFFER, differs))
+    {
+        glBindFramebuffer(target, framebuffer);
+        if (draw)
+            state.drawFramebuffer = framebuffer;
+        if (read)
+            state.readFramebuffer = framebuffer;
+    }
+}
+
+void GLState::Enable(GLenum capability)
+{
+    int slot = capabilitySlot(capability);
+    if (changes(CALL_CAPABILITY, slot < 0 || state.capabilities[slot] != 1))
+    {
+        glEnable(capability);
+        if (slot >= 0)
+            state.capabilities[slot] = 1;
+    }
+}
+
+void GLState::Disable(GLenum capability)
+{
+    int slot = capabilitySlot(capability);
+    if (changes(CALL_CAPABILITY, slot < 0 || state.capabilities[slot] != 0))
+    {
+        glDisable(capability);
+        if (slot >= 0)
+            state.capabilities[slot] = 0;
+    }
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+    if (changes(CALL_DEPTH, state.depthFunc != func))
+    {
+        glDepthFunc(func);
+        state.depthFunc = func;
+    }
+}
+
+void GLState::DepthMask(bool write)
+{
+    if (changes(CALL_DEPTH, state.depthMask != (unsigned int)write))
+    {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        state.depthMask = write;
+    }
+}
+
+void GLState::BlendFunc(GLenum src, GLenum dst)
+{
+    if (changes(CALL_BLEND, state.blendSrc != src || state.blendDst != dst))
+    {
+        glBlendFunc(src, dst);
+        state.blendSrc = src;
+        state.blendDst = dst;
+    }
+}
+
+void GLState::Viewport(int x, int y, int width, int height)
+{
+    int *v = state.viewport;
+    if (changes(CALL_VIEWPORT, v[0] != x || v[1] != y || v[2] != width || v[3] != height))
+    {
+        glViewport(x, y, width, height);
+        v[0] = x;
+        v[1] = y;
+        v[2] = width;
+        v[3] = height;
+    }
+}
+
+void GLState::CullFace(GLenum face)
+{
+    if (changes(CALL_CULL_FACE, state.cullFace != face))
+    {
+        glCullFace(face);
+        state.cullFace = face;
+    }
+}
+
+// ---- DRAWS ----
+
+static void countDraw(GLenum mode, int count, int instances)
+{
+    unsigned long long triangles = 0;
+    if (mode == GL_TRIANGLES)
+        triangles = count / 3;
+    else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2)
+        triangles = count - 2;
+    currentFrame.drawCalls++;
+    currentFrame.triangles += triangles * instances;
+}
+
+void GLState::DrawArrays(GLenum mode, int first, int count)
+{
+    countDraw(mode, count, 1);
+    glDrawArrays(mode, first, count);
+}
+
+void GLState::DrawElements(GLenum mode, int count, GLenum type, const void* indices)
+{
+    countDraw(mode, count, 1);
+    glDrawElements(mode, count, type, indices);
+}
+
+void GLState::DrawElementsInstanced(GLenum mode, int count, GLenum type, const void* indices, int instances)
+{
+    countDraw(mode, count, instances);
+    glDrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+void GLState::MultiDrawElementsBaseVertex(GLenum mode, const int* counts, GLenum type, const void* const* indices,
+                                          int drawCount, const int* baseVertices)
+{
+    int count = 0;
+    for (int i = 0; i < drawCount; i++)
+        count += counts[i];
+    countDraw(mode, count, 1);
+    glMultiDrawElementsBaseVertex(mode, counts, type, indices, drawCount, baseVertices);
+}
+
+// ---- INVALIDATION ----
+
+void GLState::ForgetTexture(unsigned int texture)
+{
+    for (unsigned int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+        for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+            if (state.textures[unit][slot] == texture)
+                state.textures[unit][slot] = UNKNOWN;
+}
+
+void GLState::ForgetSampler(unsigned int sampler)
+{
+    for (unsigned int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+        if (state.samplers[unit] == sampler)
+            state.samplers[unit] = UNKNOWN;
+}
+
+void GLState::ForgetBuffer(unsigned int buffer)
+{
+    for (unsigned int slot = 0; slot < BUFFER_SLOT_COUNT; slot++)
+        if (state.buffers[slot] == buffer)
+            state.buffers[slot] = UNKNOWN;
+    for (unsigned int i = 0; i < GL_STATE_BUFFER_BINDINGS; i++)
+        if (state.uniformRanges[i].buffer == buffer)
+            state.uniformRanges[i].buffer = UNKNOWN;
+}
+
+void GLState::ForgetVertexArray(unsigned int vao)
+{
+    if (state.vertexArray == vao)
+        state.vertexArray = UNKNOWN;
+}
+
+void GLState::ForgetProgram(unsigned int program)
+{
+    if (state.program == program)
+        state.program = UNKNOWN;
+}
+
+void GLState::Invalidate()
+{
+    stateKnown = false;
+}
+
+// ---- STATS ----
+
+void GLState::EndFrame()
+{
+    lastFrame = currentFrame;
+    memset(&currentFrame, 0, sizeof(currentFrame));
+}
+
+const GLStateStats &GLState::LastFrame()
+{
+    return lastFrame;
+}
+
+void GLState::WriteStatsJson(std::ostream &out)
+{
+    static const char* const names[STATE_CALL_COUNT] = {
+        "program", "vertexArray", "activeTexture", "texture", "buffer", "bufferRange",
+        "framebuffer", "capability", "depth", "blend", "viewport", "cullFace", "sampler"
+    };
+
+    unsigned int totalIssued = 0;
+    unsigned int totalRedundant = 0;
+    out << "{";
+    for (unsigned int i = 0; i < STATE_CALL_COUNT; i++)
+    {
+        out << "\"" << names[i] << "\":{\"issued\":" << lastFrame.issued[i] << ",\"redundant\":" << lastFrame.redundant[i] << "},";
+        totalIssued += lastFrame.issued[i];
+        totalRedundant += lastFrame.redundant[i];
+    }
+    out << "\"total\":{\"issued\":" << totalIssued << ",\"redundant\":" << totalRedundant << "},"
+        << "\"draws\":{\"calls\":" << lastFrame.drawCalls << ",\"triangles\":" << lastFrame.triangles << "}}";
+}
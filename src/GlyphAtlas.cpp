@@ -0,0 +1,120 @@
+#include "GlyphAtlas.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+
+#include <cstring>
+
+// empty texels left around every glyph so linear filtering never picks up a neighbour
+const int GLYPH_PADDING = 1;
+// a shelf taller than this factor of the glyph height wastes too much space, open a new one instead
+const float SHELF_SLACK = 1.3f;
+
+GlyphAtlas::GlyphAtlas(int width, int height, int pages) : Width(width), Height(height), Pages(pages), pages(pages)
+{
+    for (int i = 0; i < pages; i++)
+    {
+        this->pages[i].dirtyMinY = height;
+        this->pages[i].dirtyMaxY = 0;
+    }
+
+    // storage for every page up front, this is the atlas' whole memory budget
+    glGenTextures(1, &TextureID);
+    GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, TextureID);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, width, height, pages, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    MemoryTracker::Track(KIND_TEXTURE, TextureID, MEMORY_FONT, MemoryTracker::TextureBytes(GL_R8, width, height, pages), "glyph atlas");
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+    GLState::ForgetTexture(TextureID);
+    MemoryTracker::Release(KIND_TEXTURE, TextureID);
+    glDeleteTextures(1, &TextureID);
+}
+
+bool GlyphAtlas::Pack(int page, int w, int h, glm::ivec2 &origin)
+{
+    std::vector<Shelf> &shelves = pages[page].shelves;
+    int paddedW = w + GLYPH_PADDING;
+    int paddedH = h + GLYPH_PADDING;
+
+    // best fit: the lowest shelf that still has room and doesn't waste too much height
+    Shelf* best = NULL;
+    for (unsigned int i = 0; i < shelves.size(); i++)
+    {
+        Shelf &shelf = shelves[i];
+        if (shelf.height < paddedH || shelf.height > paddedH * SHELF_SLACK + 1 || shelf.x + paddedW > Width)
+            continue;
+        if (!best || shelf.height < best->height)
+            best = &shelf;
+    }
+
+    if (!best)
+    {
+        int y = shelves.empty() ? GLYPH_PADDING : shelves.back().y + shelves.back().height;
+        if (y + paddedH > Height || GLYPH_PADDING + paddedW > Width)
+            return false;
+        Shelf shelf = { y, paddedH, GLYPH_PADDING };
+        shelves.push_back(shelf);
+        best = &shelves.back();
+    }
+
+    origin = glm::ivec2(best->x, best->y);
+    best->x += paddedW;
+    return true;
+}
+
+void GlyphAtlas::Write(int page, glm::ivec2 origin, int w, int h, const unsigned char* bitmap)
+{
+    Page &p = pages[page];
+    if (p.pixels.empty())
+        p.pixels.assign(Width * Height, 0);
+
+    for (int row = 0; row < h; row++)
+        memcpy(&p.pixels[(origin.y + row) * Width + origin.x], bitmap + row * w, w);
+
+    if (origin.y < p.dirtyMinY)
+        p.dirtyMinY = origin.y;
+    if (origin.y + h > p.dirtyMaxY)
+        p.dirtyMaxY = origin.y + h;
+}
+
+void GlyphAtlas::Upload()
+{
+    bool bound = false;
+    for (int i = 0; i < Pages; i++)
+    {
+        Page &p = pages[i];
+        if (p.dirtyMaxY <= p.dirtyMinY)
+            continue;
+
+        if (!bound)
+        {
+            GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, TextureID);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            bound = true;
+        }
+        // only the rows that changed, as one contiguous block
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, p.dirtyMinY, i, Width, p.dirtyMaxY - p.dirtyMinY, 1,
+                        GL_RED, GL_UNSIGNED_BYTE, &p.pixels[p.dirtyMinY * Width]);
+        p.dirtyMinY = Height;
+        p.dirtyMaxY = 0;
+    }
+    if (bound)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void GlyphAtlas::Clear(int page)
+{
+    Page &p = pages[page];
+    p.shelves.clear();
+    if (!p.pixels.empty())
+    {
+        memset(&p.pixels[0], 0, p.pixels.size());
+        p.dirtyMinY = 0;
+        p.dirtyMaxY = Height;
+    }
+}
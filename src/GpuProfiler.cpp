@@ -0,0 +1,112 @@
+#include "GpuProfiler.h"
+
+#include <glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// how often the GPU clock offset is measured again, timestamps drift apart slowly
+const unsigned long long CALIBRATION_NS = 1000000000ull;
+const unsigned int ZONE_DROPPED = ~0u;
+
+// only touched on the GL thread
+struct GpuZone
+{
+    const char* name;
+    bool closed;
+};
+static unsigned int queries[2 * GpuProfiler::ZONES_IN_FLIGHT];
+static GpuZone zones[GpuProfiler::ZONES_IN_FLIGHT];
+static unsigned long long zoneWrite = 0;
+static unsigned long long zoneRead = 0;
+static std::vector<unsigned int> openZones;
+static long long clockOffset = 0;
+static unsigned long long calibrated = 0;
+static bool ready = false;
+static ProfileBuffer* track = NULL;
+
+static void calibrate()
+{
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    unsigned long long cpuNow = Profiler::Now();
+    clockOffset = (long long)cpuNow - (long long)gpuNow;
+    calibrated = cpuNow;
+}
+
+void GpuProfiler::Init()
+{
+    glGenQueries(2 * ZONES_IN_FLIGHT, queries);
+    if (!track)
+        track = Profiler::CreateTrack("GPU");
+    calibrate();
+    ready = true;
+}
+
+void GpuProfiler::Shutdown()
+{
+    if (!ready)
+        return;
+    // whatever finished still makes it into the trace
+    glFinish();
+    Collect();
+    glDeleteQueries(2 * ZONES_IN_FLIGHT, queries);
+    zoneWrite = 0;
+    zoneRead = 0;
+    openZones.clear();
+    ready = false;
+}
+
+void GpuProfiler::Begin(const char* name)
+{
+    // every begin pushes, so the matching end pops the right zone even when this one is not recorded
+    if (!ready || !Profiler::Enabled() || zoneWrite - zoneRead >= ZONES_IN_FLIGHT)
+    {
+        openZones.push_back(ZONE_DROPPED);
+        return;
+    }
+    unsigned int slot = zoneWrite++ % ZONES_IN_FLIGHT;
+    zones[slot].name = name;
+    zones[slot].closed = false;
+    glQueryCounter(queries[2 * slot], GL_TIMESTAMP);
+    openZones.push_back(slot);
+}
+
+void GpuProfiler::End()
+{
+    if (openZones.empty())
+        return;
+    unsigned int slot = openZones.back();
+    openZones.pop_back();
+    if (slot == ZONE_DROPPED)
+        return;
+    glQueryCounter(queries[2 * slot + 1], GL_TIMESTAMP);
+    zones[slot].closed = true;
+}
+
+void GpuProfiler::Collect()
+{
+    if (!ready)
+        return;
+    if (Profiler::Now() - calibrated > CALIBRATION_NS)
+        calibrate();
+
+    // queries finish in order, stop at the first one that isn't available yet
+    while (zoneRead < zoneWrite)
+    {
+        unsigned int slot = zoneRead % ZONES_IN_FLIGHT;
+        if (!zones[slot].closed)
+            break;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[2 * slot + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(queries[2 * slot], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[2 * slot + 1], GL_QUERY_RESULT, &end);
+        Profiler::Record(track, zones[slot].name, (long long)start + clockOffset, (long long)end + clockOffset);
+        zoneRead++;
+    }
+}
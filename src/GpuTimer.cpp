@@ -0,0 +1,62 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() : writeIndex(0), pending(0), totalNs(0), sampleCount(0)
+{
+    glGenQueries(GPU_TIMER_QUERIES, queries);
+}
+
+GpuTimer::~GpuTimer()
+{
+    glDeleteQueries(GPU_TIMER_QUERIES, queries);
+}
+
+void GpuTimer::Begin()
+{
+    // every query in the ring is still in flight, skip this sample rather than wait for one
+    if (pending == GPU_TIMER_QUERIES)
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, queries[writeIndex]);
+}
+
+void GpuTimer::End()
+{
+    if (pending == GPU_TIMER_QUERIES)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    writeIndex = (writeIndex + 1) % GPU_TIMER_QUERIES;
+    pending++;
+}
+
+void GpuTimer::Poll()
+{
+    while (pending > 0)
+    {
+        unsigned int oldest = (writeIndex + GPU_TIMER_QUERIES - pending) % GPU_TIMER_QUERIES;
+        int available = 0;
+        glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &elapsed);
+        totalNs += elapsed;
+        sampleCount++;
+        pending--;
+    }
+}
+
+double GpuTimer::AverageMs() const
+{
+    return sampleCount > 0 ? (double)totalNs / sampleCount / 1.0e6 : 0.0;
+}
+
+unsigned int GpuTimer::Samples() const
+{
+    return sampleCount;
+}
+
+void GpuTimer::Reset()
+{
+    totalNs = 0;
+    sampleCount = 0;
+}
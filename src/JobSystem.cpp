@@ -0,0 +1,408 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <string>
+
+// the system and index of the thread it runs on, so Run() knows whose deque to push to
+static thread_local const JobSystem* threadSystem = NULL;
+static thread_local int threadIndex = -1;
+
+// failed searches before an idle worker goes to sleep
+const unsigned int IDLE_SPINS = 64;
+
+JobCounter::JobCounter()
+    : pending(0)
+{
+}
+
+bool JobCounter::Done() const
+{
+    if (pending.load(std::memory_order_acquire) != 0)
+        return false;
+    // the thread that took it to zero may still be releasing continuations, wait until it is out
+    std::lock_guard<std::mutex> lock(mutex);
+    return true;
+}
+
+// ---- DEQUE ----
+
+JobSystem::Deque::Deque()
+    : top(0), bottom(0)
+{
+    for (unsigned int i = 0; i < MAX_JOBS_PER_THREAD; i++)
+        jobs[i].store(NULL, std::memory_order_relaxed);
+}
+
+bool JobSystem::Deque::Push(Job* job)
+{
+    long long b = bottom.load(std::memory_order_relaxed);
+    long long t = top.load(std::memory_order_acquire);
+    if (b - t >= (long long)MAX_JOBS_PER_THREAD)
+        return false;
+    jobs[b & (MAX_JOBS_PER_THREAD - 1)].store(job, std::memory_order_relaxed);
+    // publishes the job slot and its contents to thieves that read bottom with acquire
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+Job* JobSystem::Deque::Pop()
+{
+    long long b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long t = top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        // empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return NULL;
+    }
+    Job* job = jobs[b & (MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // the last job, race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = NULL;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobSystem::Deque::Steal()
+{
+    long long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return NULL;
+
+    Job* job = jobs[t & (MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return NULL;
+    return job;
+}
+
+// ---- SYSTEM ----
+
+JobSystem::JobSystem(unsigned int threadCount)
+    : mainThread(std::this_thread::get_id()), queued(0), sleeping(0), stopping(false)
+{
+    if (threadCount == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 0;
+    }
+
+    for (unsigned int i = 0; i <= threadCount; i++)
+    {
+        Thread* thread = new Thread();
+        thread->free = NULL;
+        for (unsigned int j = MAX_JOBS_PER_THREAD; j > 0; j--)
+        {
+            thread->pool[j - 1].owner = (int)i;
+            thread->pool[j - 1].nextFree = thread->free;
+            thread->free = &thread->pool[j - 1];
+        }
+        thread->released.store(NULL, std::memory_order_relaxed);
+        thread->random = 2654435761u * (i + 1);
+        threads.push_back(thread);
+    }
+
+    threadSystem = this;
+    threadIndex = 0;
+    for (unsigned int i = 1; i <= threadCount; i++)
+        workers.push_back(std::thread(&JobSystem::work, this, (int)i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    for (unsigned int i = 0; i < threads.size(); i++)
+        delete threads[i];
+    if (threadSystem == this)
+    {
+        threadSystem = NULL;
+        threadIndex = -1;
+    }
+}
+
+void JobSystem::Run(JobFunction function, void* data, JobCounter* counter, JobCounter* dependency)
+{
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    int thread = currentThread();
+    if (thread < 0)
+    {
+        std::cout << "ERROR::JOBS::RUN_FROM_FOREIGN_THREAD" << std::endl;
+        function(data);
+        finish(-1, counter);
+        return;
+    }
+
+    Job* job = allocate(thread);
+    while (!job)
+    {
+        // every slot of this thread holds a job that hasn't run yet
+        if (!dependency || dependency->Done())
+        {
+            function(data);
+            finish(thread, counter);
+            return;
+        }
+        // a continuation can't run before its dependency, help out until one of the slots comes back
+        Job* other = find(thread);
+        if (other)
+            execute(thread, other);
+        else
+            std::this_thread::yield();
+        job = allocate(thread);
+    }
+    job->function = function;
+    job->data = data;
+    job->counter = counter;
+
+    if (dependency)
+    {
+        // the thread that finishes the dependency takes the continuations under the same lock,
+        // so the job is either parked before that or sees the counter at zero
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->pending.load(std::memory_order_acquire) != 0)
+        {
+            dependency->continuations.push_back(job);
+            return;
+        }
+    }
+    push(thread, job);
+}
+
+void JobSystem::RunOnMainThread(JobFunction function, void* data, JobCounter* counter)
+{
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    Job job = { function, data, counter, -1, NULL };
+    std::lock_guard<std::mutex> lock(mainMutex);
+    mainJobs.push_back(job);
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+    int thread = currentThread();
+    if (thread < 0)
+    {
+        std::cout << "ERROR::JOBS::WAIT_FROM_FOREIGN_THREAD" << std::endl;
+        while (!counter->Done())
+            std::this_thread::yield();
+        return;
+    }
+
+    while (!counter->Done())
+    {
+        if (thread == 0)
+            PumpMainThread();
+        Job* job = find(thread);
+        if (job)
+            execute(thread, job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::WaitOnMainThread(JobCounter* counter)
+{
+    if (std::this_thread::get_id() != mainThread)
+    {
+        std::cout << "ERROR::JOBS::MAIN_WAIT_OFF_MAIN_THREAD" << std::endl;
+        Wait(counter);
+        return;
+    }
+    // nobody else would run the other jobs
+    if (threads.size() == 1)
+    {
+        Wait(counter);
+        return;
+    }
+
+    while (!counter->Done())
+    {
+        PumpMainThread();
+        std::this_thread::yield();
+    }
+}
+
+void JobSystem::PumpMainThread()
+{
+    if (std::this_thread::get_id() != mainThread)
+    {
+        std::cout << "ERROR::JOBS::PUMP_OFF_MAIN_THREAD" << std::endl;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        if (mainJobs.empty())
+            return;
+        mainRunning.swap(mainJobs);
+    }
+    // the jobs may queue more main thread work, that runs on the next pump
+    for (unsigned int i = 0; i < mainRunning.size(); i++)
+    {
+        mainRunning[i].function(mainRunning[i].data);
+        finish(0, mainRunning[i].counter);
+    }
+    mainRunning.clear();
+}
+
+unsigned int JobSystem::ThreadCount() const
+{
+    return threads.size();
+}
+
+int JobSystem::currentThread() const
+{
+    return threadSystem == this ? threadIndex : -1;
+}
+
+Job* JobSystem::allocate(int thread)
+{
+    Thread &owner = *threads[thread];
+    if (!owner.free)
+        owner.free = owner.released.exchange(NULL, std::memory_order_acquire);
+    Job* job = owner.free;
+    if (job)
+        owner.free = job->nextFree;
+    return job;
+}
+
+void JobSystem::release(Job* job)
+{
+    // any thread pushes, only the owner takes the whole list, so there is no ABA to worry about
+    Thread &owner = *threads[job->owner];
+    Job* head = owner.released.load(std::memory_order_relaxed);
+    do
+    {
+        job->nextFree = head;
+    } while (!owner.released.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void JobSystem::push(int thread, Job* job)
+{
+    if (!threads[thread]->deque.Push(job))
+    {
+        // full, the job runs right here instead
+        execute(thread, job);
+        return;
+    }
+
+    queued.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        // taking the lock orders this after a worker that checked queued and is about to wait
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+Job* JobSystem::find(int thread)
+{
+    Job* job = threads[thread]->deque.Pop();
+    if (!job)
+    {
+        // steal from the others, starting at a random one so thieves spread out
+        unsigned int &random = threads[thread]->random;
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        unsigned int count = threads.size();
+        for (unsigned int i = 0; i < count && !job; i++)
+        {
+            unsigned int victim = (random + i) % count;
+            if ((int)victim != thread)
+                job = threads[victim]->deque.Steal();
+        }
+    }
+    if (job)
+        queued.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::execute(int thread, Job* job)
+{
+    JobCounter* counter = job->counter;
+    job->function(job->data);
+    // the slot is only reused once its job has run, the counter was read out of it before
+    release(job);
+    finish(thread, counter);
+}
+
+void JobSystem::finish(int thread, JobCounter* counter)
+{
+    if (!counter)
+        return;
+
+    // while other jobs are left the counter can't be done, one atomic decrement is all it takes
+    int pending = counter->pending.load(std::memory_order_relaxed);
+    while (pending > 1)
+    {
+        if (counter->pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    // probably the last one: the counter may be destroyed as soon as it reads zero, so the continuations
+    // are taken and the count dropped under the lock Done() waits on
+    std::vector<Job*> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            continuations.swap(counter->continuations);
+    }
+    for (unsigned int i = 0; i < continuations.size(); i++)
+    {
+        if (thread < 0)
+            execute(thread, continuations[i]);
+        else
+            push(thread, continuations[i]);
+    }
+}
+
+void JobSystem::work(int thread)
+{
+    threadSystem = this;
+    threadIndex = thread;
+    PROFILE_THREAD_NAME(("job worker " + std::to_string(thread)).c_str());
+
+    unsigned int idle = 0;
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        Job* job = find(thread);
+        if (job)
+        {
+            execute(thread, job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping.load() || queued.load(std::memory_order_seq_cst) > 0; });
+        }
+        sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        idle = 0;
+    }
+}
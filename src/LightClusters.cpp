@@ -0,0 +1,301 @@
+#include "LightClusters.h"
+#include "GLState.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define LIGHT_CLUSTERS_SSE
+#endif
+
+// padding lights sit this far away with no radius, so they never touch a froxel
+const float CLUSTER_PAD_POSITION = 1e30f;
+
+LightClusters::LightClusters(JobSystem &jobs, unsigned int maxLights, unsigned int maxIndices)
+    : jobs(jobs), stream(maxLights * sizeof(PointLight) + CLUSTER_COUNT * 2 * sizeof(unsigned int) + maxIndices * sizeof(unsigned short)
+             + 3 * StreamBuffer::VERTEX_ALIGNMENT, 3, "light clusters"),
+      maxLights(maxLights < 65536 ? maxLights : 65536), maxIndices(maxIndices), clusterProjection(0.0f),
+      tileScale(1.0f), depthParams(0.0f), gridBase(0), indexBase(0), lightBase(0), lightCount(0)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    // three views of the same ring, each frame's data sits at a different texel offset in them
+    unsigned int* textures[] = { &gridTexture, &indexTexture, &lightTexture };
+    GLenum formats[] = { GL_RG32UI, GL_R16UI, GL_RGBA32F };
+    for (int i = 0; i < 3; i++)
+    {
+        glGenTextures(1, textures[i]);
+        GLState::BindTexture(0, GL_TEXTURE_BUFFER, *textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], stream.ID);
+    }
+}
+
+LightClusters::~LightClusters()
+{
+    unsigned int textures[] = { gridTexture, indexTexture, lightTexture };
+    for (int i = 0; i < 3; i++)
+        GLState::ForgetTexture(textures[i]);
+    glDeleteTextures(3, textures);
+}
+
+bool LightClusters::Build(const PointLight* lights, unsigned int count, const glm::mat4 &view, const glm::mat4 &projection,
+                          int screenWidth, int screenHeight)
+{
+    PROFILE_ZONE("LightClusters::Build");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (count > maxLights)
+    {
+        std::cout << "ERROR::CLUSTERS::TOO_MANY_LIGHTS " << count << std::endl;
+        count = maxLights;
+    }
+    if (projection != clusterProjection)
+        buildAabbs(projection);
+    tileScale = glm::vec2((float)CLUSTER_X / screenWidth, (float)CLUSTER_Y / screenHeight);
+
+    // froxels live in view space, move the lights there once instead of every froxel into world space
+    lightCount = count;
+    viewX.resize(count);
+    viewY.resize(count);
+    viewZ.resize(count);
+    viewRadius.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec4 p = view * glm::vec4(lights[i].position, 1.0f);
+        viewX[i] = p.x;
+        viewY[i] = p.y;
+        viewZ[i] = p.z;
+        viewRadius[i] = lights[i].radius;
+    }
+    // one job per depth slice, each writes only its own Slice
+    jobs.ParallelFor(CLUSTER_Z, 1, [this](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int z = begin; z < end; z++)
+            binSlice(z);
+    });
+
+    std::chrono::steady_clock::time_point binned = std::chrono::steady_clock::now();
+
+    // ---- COMPACT AND UPLOAD ----
+    stream.BeginFrame();
+    // two RGBA32F texels per light: position and radius, then color
+    GLintptr lightOffset = stream.Write(lights, count * sizeof(PointLight), StreamBuffer::VERTEX_ALIGNMENT);
+    if (lightOffset < 0)
+        return false;
+    lightBase = lightOffset / sizeof(glm::vec4);
+
+    unsigned int total = 0;
+    for (unsigned int z = 0; z < CLUSTER_Z; z++)
+        total += slices[z].indices.size();
+    if (total > maxIndices)
+    {
+        std::cout << "ERROR::CLUSTERS::INDEX_LIST_FULL " << total << std::endl;
+        total = maxIndices;
+    }
+
+    StreamAllocation grid = stream.Allocate(CLUSTER_COUNT * 2 * sizeof(unsigned int), StreamBuffer::VERTEX_ALIGNMENT);
+    if (grid.offset < 0)
+        return false;
+    unsigned int* cells = (unsigned int*)grid.ptr;
+    unsigned int sliceStart = 0;
+    unsigned int maxPerCluster = 0;
+    for (unsigned int z = 0; z < CLUSTER_Z; z++)
+    {
+        const Slice &slice = slices[z];
+        for (unsigned int tile = 0; tile < CLUSTER_X * CLUSTER_Y; tile++)
+        {
+            // once the list is full the remaining froxels are cut short, offsets stay in order so no gaps open up
+            unsigned int offset = sliceStart + slice.offsets[tile];
+            unsigned int cellCount = slice.counts[tile];
+            if (offset >= total)
+                cellCount = 0;
+            else if (offset + cellCount > total)
+                cellCount = total - offset;
+            cells[(z * CLUSTER_X * CLUSTER_Y + tile) * 2 + 0] = offset;
+            cells[(z * CLUSTER_X * CLUSTER_Y + tile) * 2 + 1] = cellCount;
+            if (cellCount > maxPerCluster)
+                maxPerCluster = cellCount;
+        }
+        sliceStart += slice.indices.size();
+    }
+    stream.Commit(grid);
+    gridBase = grid.offset / (2 * sizeof(unsigned int));
+
+    if (total > 0)
+    {
+        StreamAllocation indices = stream.Allocate(total * sizeof(unsigned short), StreamBuffer::VERTEX_ALIGNMENT);
+        if (indices.offset < 0)
+            return false;
+        unsigned short* out = (unsigned short*)indices.ptr;
+        unsigned int written = 0;
+        for (unsigned int z = 0; z < CLUSTER_Z && written < total; z++)
+        {
+            unsigned int n = slices[z].indices.size();
+            if (written + n > total)
+                n = total - written;
+            if (n > 0)
+                memcpy(out + written, &slices[z].indices[0], n * sizeof(unsigned short));
+            written += n;
+        }
+        stream.Commit(indices);
+        indexBase = indices.offset / sizeof(unsigned short);
+    }
+
+    std::chrono::steady_clock::time_point uploaded = std::chrono::steady_clock::now();
+    stats.binMs = std::chrono::duration<double, std::milli>(binned - start).count();
+    stats.uploadMs = std::chrono::duration<double, std::milli>(uploaded - binned).count();
+    stats.lights = count;
+    stats.indices = total;
+    stats.maxLightsPerCluster = maxPerCluster;
+    return true;
+}
+
+void LightClusters::Bind(Shader &shader)
+{
+    GLState::BindTexture(CLUSTER_GRID_UNIT, GL_TEXTURE_BUFFER, gridTexture);
+    GLState::BindTexture(CLUSTER_INDEX_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+    GLState::BindTexture(CLUSTER_LIGHT_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+
+    shader.SetInt("clusterGrid", CLUSTER_GRID_UNIT);
+    shader.SetInt("clusterIndices", CLUSTER_INDEX_UNIT);
+    shader.SetInt("clusterLights", CLUSTER_LIGHT_UNIT);
+    shader.SetInt("clusterGridBase", (int)gridBase);
+    shader.SetInt("clusterIndexBase", (int)indexBase);
+    shader.SetInt("clusterLightBase", (int)lightBase);
+    shader.SetFloat2("clusterTileScale", tileScale);
+    shader.SetFloat2("clusterDepthParams", depthParams);
+}
+
+void LightClusters::EndFrame()
+{
+    stream.EndFrame();
+}
+
+const ClusterStats &LightClusters::LastFrame() const
+{
+    return stats;
+}
+
+void LightClusters::buildAabbs(const glm::mat4 &projection)
+{
+    clusterProjection = projection;
+
+    // near and far planes back out of a glm::perspective matrix
+    float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+    float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+    for (unsigned int z = 0; z <= CLUSTER_Z; z++)
+        sliceNear[z] = zNear * pow(zFar / zNear, (float)z / CLUSTER_Z);
+
+    // slice = log(depth) * scale + bias, evaluated per fragment by the shader
+    float logRatio = log(zFar / zNear);
+    depthParams = glm::vec2(CLUSTER_Z / logRatio, -(float)CLUSTER_Z * log(zNear) / logRatio);
+
+    for (unsigned int z = 0; z < CLUSTER_Z; z++)
+    {
+        for (unsigned int y = 0; y < CLUSTER_Y; y++)
+        {
+            for (unsigned int x = 0; x < CLUSTER_X; x++)
+            {
+                // tile corners in NDC, pushed out to the near and far depth of the slice
+                float ndcX[2] = { -1.0f + 2.0f * x / CLUSTER_X, -1.0f + 2.0f * (x + 1) / CLUSTER_X };
+                float ndcY[2] = { -1.0f + 2.0f * y / CLUSTER_Y, -1.0f + 2.0f * (y + 1) / CLUSTER_Y };
+                float depth[2] = { sliceNear[z], sliceNear[z + 1] };
+
+                Aabb &box = aabbs[(z * CLUSTER_Y + y) * CLUSTER_X + x];
+                box.min = glm::vec3(1e30f);
+                box.max = glm::vec3(-1e30f);
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    float d = depth[corner >> 2];
+                    glm::vec3 p(ndcX[corner & 1] * d / projection[0][0], ndcY[(corner >> 1) & 1] * d / projection[1][1], -d);
+                    box.min = glm::vec3(fmin(box.min.x, p.x), fmin(box.min.y, p.y), fmin(box.min.z, p.z));
+                    box.max = glm::vec3(fmax(box.max.x, p.x), fmax(box.max.y, p.y), fmax(box.max.z, p.z));
+                }
+            }
+        }
+    }
+}
+
+// ---- BINNING ----
+
+void LightClusters::binSlice(unsigned int z)
+{
+    PROFILE_ZONE("bin slice");
+    Slice &slice = slices[z];
+    slice.x.clear();
+    slice.y.clear();
+    slice.z.clear();
+    slice.radius.clear();
+    slice.candidates.clear();
+    slice.indices.clear();
+
+    // only lights reaching into the slice's depth range are tested against its froxels
+    float nearDepth = sliceNear[z];
+    float farDepth = sliceNear[z + 1];
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        float depth = -viewZ[i];
+        if (depth + viewRadius[i] < nearDepth || depth - viewRadius[i] > farDepth)
+            continue;
+        slice.x.push_back(viewX[i]);
+        slice.y.push_back(viewY[i]);
+        slice.z.push_back(viewZ[i]);
+        slice.radius.push_back(viewRadius[i]);
+        slice.candidates.push_back((unsigned short)i);
+    }
+    while (slice.x.size() % 4 != 0)
+    {
+        slice.x.push_back(CLUSTER_PAD_POSITION);
+        slice.y.push_back(CLUSTER_PAD_POSITION);
+        slice.z.push_back(CLUSTER_PAD_POSITION);
+        slice.radius.push_back(0.0f);
+    }
+
+    const Aabb* boxes = &aabbs[z * CLUSTER_X * CLUSTER_Y];
+    for (unsigned int tile = 0; tile < CLUSTER_X * CLUSTER_Y; tile++)
+    {
+        const Aabb &box = boxes[tile];
+        slice.offsets[tile] = slice.indices.size();
+
+#ifdef LIGHT_CLUSTERS_SSE
+        // squared distance from each sphere center to the box, four spheres per iteration
+        __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+        __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+        __m128 minZ = _mm_set1_ps(box.min.z), maxZ = _mm_set1_ps(box.max.z);
+        __m128 zero = _mm_setzero_ps();
+        for (unsigned int g = 0; g < slice.x.size() / 4; g++)
+        {
+            __m128 cx = _mm_loadu_ps(&slice.x[g * 4]);
+            __m128 cy = _mm_loadu_ps(&slice.y[g * 4]);
+            __m128 cz = _mm_loadu_ps(&slice.z[g * 4]);
+            __m128 r = _mm_loadu_ps(&slice.radius[g * 4]);
+
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, cx), _mm_sub_ps(cx, maxX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, cy), _mm_sub_ps(cy, maxY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, cz), _mm_sub_ps(cz, maxZ)), zero);
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int hits = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_mul_ps(r, r)));
+
+            for (int lane = 0; hits; lane++, hits >>= 1)
+            {
+                if (hits & 1)
+                    slice.indices.push_back(slice.candidates[g * 4 + lane]);
+            }
+        }
+#else
+        for (unsigned int c = 0; c < slice.candidates.size(); c++)
+        {
+            float dx = fmax(fmax(box.min.x - slice.x[c], slice.x[c] - box.max.x), 0.0f);
+            float dy = fmax(fmax(box.min.y - slice.y[c], slice.y[c] - box.max.y), 0.0f);
+            float dz = fmax(fmax(box.min.z - slice.z[c], slice.z[c] - box.max.z), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= slice.radius[c] * slice.radius[c])
+                slice.indices.push_back(slice.candidates[c]);
+        }
+#endif
+        slice.counts[tile] = slice.indices.size() - slice.offsets[tile];
+    }
+}
@@ -0,0 +1,135 @@
+#include "Material.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+#include "ShaderPermutations.h"
+
+#include <iostream>
+
+const char* const MATERIAL_MAP_UNIFORMS[MATERIAL_MAP_COUNT] = {
+    "material.diffuse", "material.specular", "material.normal"
+};
+
+// the feature bit of each map, in MaterialMap order
+static const unsigned int MAP_FEATURES[MATERIAL_MAP_COUNT] = {
+    MATERIAL_DIFFUSE_MAP, MATERIAL_SPECULAR_MAP, MATERIAL_NORMAL_MAP
+};
+
+unsigned int MaterialInfoFeatures(const MaterialInfo &info)
+{
+    unsigned int features = 0;
+    for (unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+    {
+        if (info.maps[map] >= 0)
+            features |= MAP_FEATURES[map];
+    }
+    return features;
+}
+
+// ---- MATERIAL ----
+
+Material::Material(unsigned int index, const MaterialInfo &info, const TextureLayer maps[MATERIAL_MAP_COUNT])
+    : index(index), features(MaterialInfoFeatures(info))
+{
+    params.diffuse = info.diffuse;
+    params.shininess = info.shininess;
+    params.specular = info.specular;
+    params.pad0 = 0.0f;
+    params.layers = glm::uvec4(0);
+    for (unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+    {
+        textures[map] = info.maps[map] >= 0 ? maps[map].texture : 0;
+        params.layers[map] = info.maps[map] >= 0 ? maps[map].layer : 0;
+        // an image that failed to decode has no array; its unit would still hold another material's
+        if (textures[map] == 0)
+            features &= ~MAP_FEATURES[map];
+    }
+}
+
+unsigned int Material::Index() const
+{
+    return index;
+}
+
+unsigned int Material::Features() const
+{
+    return features;
+}
+
+unsigned int Material::Texture(MaterialMap map) const
+{
+    return textures[map];
+}
+
+const MaterialParams &Material::Params() const
+{
+    return params;
+}
+
+// ---- LIBRARY ----
+
+MaterialLibrary::MaterialLibrary(const std::string &owner) : owner(owner), refused(0)
+{
+    glGenBuffers(1, &UBO);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, UBO);
+    // the whole block, a bound range smaller than the block as the shaders declare it is undefined
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialBlock), NULL, GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, UBO, MEMORY_GEOMETRY, sizeof(MaterialBlock), owner);
+
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+    for (unsigned int i = 0; i < materials.size(); i++)
+        delete materials[i];
+    GLState::ForgetBuffer(UBO);
+    MemoryTracker::Release(KIND_BUFFER, UBO);
+    glDeleteBuffers(1, &UBO);
+    GLState::ForgetSampler(sampler);
+    glDeleteSamplers(1, &sampler);
+}
+
+const Material* MaterialLibrary::Add(const MaterialInfo &info, const TextureLayer maps[MATERIAL_MAP_COUNT])
+{
+    if (materials.size() == MAX_MATERIALS)
+    {
+        if (refused++ == 0)
+            std::cout << "ERROR::MATERIAL::TOO_MANY_MATERIALS " << owner << " only the first " << MAX_MATERIALS << " are built" << std::endl;
+        return NULL;
+    }
+    Material* material = new Material(materials.size(), info, maps);
+    materials.push_back(material);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, material->Index() * sizeof(MaterialParams), sizeof(MaterialParams), &material->Params());
+    return material;
+}
+
+const Material &MaterialLibrary::Get(unsigned int index) const
+{
+    return *materials[index];
+}
+
+unsigned int MaterialLibrary::Count() const
+{
+    return materials.size();
+}
+
+void MaterialLibrary::Bind() const
+{
+    GLState::BindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BINDING, UBO, 0, sizeof(MaterialBlock));
+    for (unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+        GLState::BindSampler(MATERIAL_TEXTURE_UNIT + map, sampler);
+}
+
+void MaterialLibrary::BindTextures(const Material &material) const
+{
+    for (unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+    {
+        if (material.Texture((MaterialMap)map) != 0)
+            GLState::BindTexture(MATERIAL_TEXTURE_UNIT + map, GL_TEXTURE_2D_ARRAY, material.Texture((MaterialMap)map));
+    }
+}
@@ -0,0 +1,187 @@
+#include "MaterialBatch.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+#include <cstddef>
+#include <iostream>
+
+// meshes that bind the same arrays can share a draw, whatever their parameters and layers
+static bool sameTextures(const Material &a, const Material &b)
+{
+    if (a.Features() != b.Features())
+        return false;
+    for (unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+    {
+        if (a.Texture((MaterialMap)map) != b.Texture((MaterialMap)map))
+            return false;
+    }
+    return true;
+}
+
+MaterialBatch::MaterialBatch(const std::string &owner) : owner(owner), library(NULL), VAO(0), VBO(0), materialVBO(0), nodeVBO(0), EBO(0), nodesUBO(0)
+{
+}
+
+MaterialBatch::~MaterialBatch()
+{
+    if (VAO == 0)
+        return;
+    GLState::ForgetVertexArray(VAO);
+    glDeleteVertexArrays(1, &VAO);
+    unsigned int buffers[5] = { VBO, materialVBO, nodeVBO, EBO, nodesUBO };
+    for (unsigned int i = 0; i < 5; i++)
+    {
+        GLState::ForgetBuffer(buffers[i]);
+        MemoryTracker::Release(KIND_BUFFER, buffers[i]);
+    }
+    glDeleteBuffers(5, buffers);
+}
+
+void MaterialBatch::Build(const std::vector<Mesh> &meshes, const MaterialLibrary &library, const NodeHierarchy &nodes)
+{
+    PROFILE_ZONE("MaterialBatch::Build");
+    this->library = &library;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned short> materials;
+    std::vector<unsigned short> meshNodeSlots;
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> dropped;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        const Mesh &mesh = meshes[i];
+        // its material was past what the library holds
+        if (mesh.material >= library.Count())
+        {
+            dropped.push_back(i);
+            continue;
+        }
+        const Material &material = library.Get(mesh.material);
+
+        unsigned int group = 0;
+        while (group < groups.size() && !sameTextures(*groups[group].material, material))
+            group++;
+        if (group == groups.size())
+        {
+            Group created;
+            created.material = &material;
+            groups.push_back(created);
+        }
+        unsigned int slot = 0;
+        while (slot < meshNodes.size() && meshNodes[slot] != mesh.node)
+            slot++;
+        if (slot == meshNodes.size() && slot < MAX_MESH_NODES)
+            meshNodes.push_back(mesh.node);
+        else if (slot == MAX_MESH_NODES)
+        {
+            // drawn where the first node is, which is wrong but visible
+            std::cout << "ERROR::MATERIAL_BATCH::TOO_MANY_MESH_NODES " << owner << std::endl;
+            slot = 0;
+        }
+
+        groups[group].counts.push_back(mesh.indices.size());
+        groups[group].offsets.push_back((void*)(indices.size() * sizeof(unsigned int)));
+        groups[group].baseVertices.push_back(vertices.size());
+
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        materials.insert(materials.end(), mesh.vertices.size(), (unsigned short)material.Index());
+        meshNodeSlots.insert(meshNodeSlots.end(), mesh.vertices.size(), (unsigned short)slot);
+        indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+    }
+    if (!dropped.empty())
+    {
+        std::cout << "ERROR::MATERIAL_BATCH::MESHES_DROPPED " << owner << " " << dropped.size() << " meshes without a material:";
+        for (unsigned int i = 0; i < dropped.size(); i++)
+            std::cout << " " << dropped[i];
+        std::cout << std::endl;
+    }
+    if (vertices.empty() || indices.empty())
+        return;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &materialVBO);
+    glGenBuffers(1, &nodeVBO);
+    glGenBuffers(1, &EBO);
+    GLState::BindVertexArray(VAO);
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, VBO, MEMORY_GEOMETRY, vertices.size() * sizeof(Vertex), owner);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, materialVBO);
+    glBufferData(GL_ARRAY_BUFFER, materials.size() * sizeof(unsigned short), &materials[0], GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, materialVBO, MEMORY_GEOMETRY, materials.size() * sizeof(unsigned short), owner);
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_SHORT, sizeof(unsigned short), (void*)0);
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, nodeVBO);
+    glBufferData(GL_ARRAY_BUFFER, meshNodeSlots.size() * sizeof(unsigned short), &meshNodeSlots[0], GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, nodeVBO, MEMORY_GEOMETRY, meshNodeSlots.size() * sizeof(unsigned short), owner);
+    glEnableVertexAttribArray(6);
+    glVertexAttribIPointer(6, 1, GL_UNSIGNED_SHORT, sizeof(unsigned short), (void*)0);
+
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, EBO, MEMORY_GEOMETRY, indices.size() * sizeof(unsigned int), owner);
+
+    glGenBuffers(1, &nodesUBO);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, nodesUBO);
+    // the whole block, a bound range smaller than the block as the shaders declare it is undefined
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(NodesBlock), NULL, GL_DYNAMIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, nodesUBO, MEMORY_GEOMETRY, sizeof(NodesBlock), owner);
+    UpdateNodes(nodes);
+}
+
+void MaterialBatch::UpdateNodes(const NodeHierarchy &nodes)
+{
+    if (nodesUBO == 0)
+        return;
+    std::vector<glm::mat4> worlds(meshNodes.size());
+    std::vector<NormalMatrix> normalMatrices(meshNodes.size());
+    for (unsigned int i = 0; i < meshNodes.size(); i++)
+        worlds[i] = nodes.World(meshNodes[i]);
+    ComputeNormalMatrices(&worlds[0], &normalMatrices[0], worlds.size());
+
+    std::vector<ObjectBlock> blocks(meshNodes.size());
+    for (unsigned int i = 0; i < meshNodes.size(); i++)
+    {
+        blocks[i].model = worlds[i];
+        blocks[i].normalMatrix = normalMatrices[i];
+    }
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, nodesUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, blocks.size() * sizeof(ObjectBlock), &blocks[0]);
+}
+
+void MaterialBatch::Draw(ShaderPermutations &shaders)
+{
+    if (VAO == 0)
+        return;
+    GLState::BindVertexArray(VAO);
+    GLState::BindBufferRange(GL_UNIFORM_BUFFER, NODES_BINDING, nodesUBO, 0, sizeof(NodesBlock));
+    library->Bind();
+    for (unsigned int i = 0; i < groups.size(); i++)
+    {
+        const Group &group = groups[i];
+        shaders.Get(group.material->Features()).Use();
+        // the arrays of the previous group or model are mostly still there
+        library->BindTextures(*group.material);
+        GLState::MultiDrawElementsBaseVertex(GL_TRIANGLES, &group.counts[0], GL_UNSIGNED_INT, &group.offsets[0],
+                                             group.counts.size(), &group.baseVertices[0]);
+    }
+}
+
+unsigned int MaterialBatch::GroupCount() const
+{
+    return groups.size();
+}
@@ -0,0 +1,191 @@
+#include "MemoryTracker.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+struct Allocation
+{
+    MemoryCategory category;
+    size_t bytes;
+    std::string owner;
+};
+
+static const char* const CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+    "geometry", "texture", "font", "staging", "renderTarget"
+};
+static const char* const KIND_NAMES[MEMORY_KIND_COUNT] = {
+    "buffer", "texture", "renderbuffer", "cpu"
+};
+
+// live bytes of one owner, GL objects per category and CPU memory in one sum
+struct OwnerBytes
+{
+    size_t bytes[MEMORY_CATEGORY_COUNT];
+    size_t cpu;
+};
+
+static std::mutex mutex;
+static std::map<std::pair<int, unsigned long long>, Allocation> allocations;
+// [category][gpu, cpu]
+static MemoryTotals totals[MEMORY_CATEGORY_COUNT][2];
+static MemoryTotals sideTotals[2];
+
+static void add(MemoryTotals &totals, size_t bytes)
+{
+    totals.live += bytes;
+    totals.allocations++;
+    if (totals.live > totals.highWater)
+        totals.highWater = totals.live;
+}
+
+static void remove(MemoryTotals &totals, size_t bytes)
+{
+    totals.live -= bytes;
+    totals.allocations--;
+}
+
+void MemoryTracker::Track(MemoryKind kind, unsigned long long id, MemoryCategory category, size_t bytes, const std::string &owner)
+{
+    int side = kind == KIND_CPU ? 1 : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::pair<int, unsigned long long> key(kind, id);
+    std::map<std::pair<int, unsigned long long>, Allocation>::iterator found = allocations.find(key);
+    if (found != allocations.end())
+    {
+        // specified again, the old storage is gone
+        remove(totals[found->second.category][side], found->second.bytes);
+        remove(sideTotals[side], found->second.bytes);
+    }
+    Allocation &allocation = allocations[key];
+    allocation.category = category;
+    allocation.bytes = bytes;
+    allocation.owner = owner;
+    add(totals[category][side], bytes);
+    add(sideTotals[side], bytes);
+}
+
+void MemoryTracker::Release(MemoryKind kind, unsigned long long id)
+{
+    int side = kind == KIND_CPU ? 1 : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::pair<int, unsigned long long>, Allocation>::iterator found = allocations.find(std::make_pair((int)kind, id));
+    if (found == allocations.end())
+        return;
+    remove(totals[found->second.category][side], found->second.bytes);
+    remove(sideTotals[side], found->second.bytes);
+    allocations.erase(found);
+}
+
+size_t MemoryTracker::TextureBytes(GLenum internalFormat, int width, int height, int layers, bool mipmapped)
+{
+    size_t texel;
+    switch (internalFormat)
+    {
+        case GL_RED:
+        case GL_R8:                 texel = 1; break;
+        case GL_RG:
+        case GL_RG8:
+        case GL_R16UI:              texel = 2; break;
+        case GL_RGB:
+        case GL_RGB8:               texel = 3; break;
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH24_STENCIL8:
+        case GL_RG16:
+        case GL_RGB10_A2:
+        case GL_RGBA:
+        case GL_RGBA8:              texel = 4; break;
+        case GL_RG32UI:             texel = 8; break;
+        case GL_RGBA32F:            texel = 16; break;
+        default:                    texel = 4; break;
+    }
+    size_t bytes = texel * width * height * layers;
+    return mipmapped ? bytes + bytes / 3 : bytes;
+}
+
+MemoryTotals MemoryTracker::Category(MemoryCategory category)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals[category][0];
+}
+
+MemoryTotals MemoryTracker::Gpu()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sideTotals[0];
+}
+
+MemoryTotals MemoryTracker::Cpu()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sideTotals[1];
+}
+
+static void writeTotals(std::ostream &out, const MemoryTotals &totals)
+{
+    out << "{\"live\":" << totals.live << ",\"highWater\":" << totals.highWater << ",\"allocations\":" << totals.allocations << "}";
+}
+
+void MemoryTracker::WriteJson(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const char* const sides[2] = { "gpu", "cpu" };
+    out << "{";
+    for (int side = 0; side < 2; side++)
+    {
+        out << "\"" << sides[side] << "\":{\"total\":";
+        writeTotals(out, sideTotals[side]);
+        for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        {
+            out << ",\"" << CATEGORY_NAMES[i] << "\":";
+            writeTotals(out, totals[i][side]);
+        }
+        out << "},";
+    }
+
+    std::map<std::string, OwnerBytes> owners;
+    for (std::map<std::pair<int, unsigned long long>, Allocation>::const_iterator it = allocations.begin(); it != allocations.end(); ++it)
+    {
+        OwnerBytes &owner = owners[it->second.owner];
+        if (it->first.first == KIND_CPU)
+            owner.cpu += it->second.bytes;
+        else
+            owner.bytes[it->second.category] += it->second.bytes;
+    }
+    out << "\"owners\":{";
+    for (std::map<std::string, OwnerBytes>::const_iterator it = owners.begin(); it != owners.end(); ++it)
+    {
+        out << (it == owners.begin() ? "" : ",") << "\"" << it->first << "\":{";
+        bool first = true;
+        for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        {
+            if (it->second.bytes[i] == 0)
+                continue;
+            out << (first ? "" : ",") << "\"" << CATEGORY_NAMES[i] << "\":" << it->second.bytes[i];
+            first = false;
+        }
+        if (it->second.cpu > 0)
+            out << (first ? "" : ",") << "\"cpu\":" << it->second.cpu;
+        out << "}";
+    }
+    out << "}}";
+}
+
+unsigned int MemoryTracker::ReportLeaks(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned int leaks = 0;
+    size_t bytes = 0;
+    for (std::map<std::pair<int, unsigned long long>, Allocation>::const_iterator it = allocations.begin(); it != allocations.end(); ++it)
+    {
+        if (it->first.first == KIND_CPU)
+            continue;
+        out << "ERROR::MEMORY::LEAKED " << KIND_NAMES[it->first.first] << " " << it->first.second << " of " << it->second.owner
+            << " (" << CATEGORY_NAMES[it->second.category] << ", " << it->second.bytes << " bytes)" << std::endl;
+        leaks++;
+        bytes += it->second.bytes;
+    }
+    if (leaks > 0)
+        out << "ERROR::MEMORY::" << leaks << " GL objects leaked, " << bytes << " bytes" << std::endl;
+    return leaks;
+}
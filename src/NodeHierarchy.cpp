@@ -0,0 +1,72 @@
+#include "NodeHierarchy.h"
+
+#include <iostream>
+
+NodeHierarchy::NodeHierarchy() : firstChanged(0)
+{
+}
+
+unsigned int NodeHierarchy::Add(int parent, const glm::mat4 &local)
+{
+    unsigned int node = parents.size();
+    if (parent >= (int)node)
+    {
+        std::cout << "ERROR::NODE_HIERARCHY::PARENT_AFTER_CHILD " << parent << " " << node << std::endl;
+        parent = -1;
+    }
+    parents.push_back(parent);
+    locals.push_back(local);
+    worlds.push_back(local);
+    changed.push_back(0);
+    SetLocal(node, local);
+    return node;
+}
+
+void NodeHierarchy::SetLocal(unsigned int node, const glm::mat4 &local)
+{
+    locals[node] = local;
+    changed[node] = 1;
+    if (node < firstChanged)
+        firstChanged = node;
+}
+
+unsigned int NodeHierarchy::Update()
+{
+    unsigned int count = parents.size();
+    unsigned int updated = 0;
+    for (unsigned int node = firstChanged; node < count; node++)
+    {
+        int parent = parents[node];
+        if (parent >= 0 && changed[parent])
+            changed[node] = 1;
+        if (!changed[node])
+            continue;
+        worlds[node] = parent >= 0 ? worlds[parent] * locals[node] : locals[node];
+        updated++;
+    }
+    // only cleared afterwards, the children read their parent's flag during the pass
+    for (unsigned int node = firstChanged; node < count; node++)
+        changed[node] = 0;
+    firstChanged = count;
+    return updated;
+}
+
+unsigned int NodeHierarchy::Count() const
+{
+    return parents.size();
+}
+
+int NodeHierarchy::Parent(unsigned int node) const
+{
+    return parents[node];
+}
+
+const glm::mat4 &NodeHierarchy::Local(unsigned int node) const
+{
+    return locals[node];
+}
+
+const glm::mat4 &NodeHierarchy::World(unsigned int node) const
+{
+    return worlds[node];
+}
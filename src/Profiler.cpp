@@ -0,0 +1,161 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one thread's zones, written by that thread only and read by the exporter
+struct ProfileBuffer
+{
+    std::string name;
+    unsigned int id;
+    bool thread;                            // false for a track made with CreateTrack
+    std::atomic<unsigned long long> head;   // zones ever recorded, the next one goes to head % EVENTS_PER_THREAD
+    ProfileEvent events[Profiler::EVENTS_PER_THREAD];
+};
+
+// the exporter skips the oldest zones of a full ring, the writer may be overwriting them meanwhile
+const unsigned int EXPORT_MARGIN = 4096;
+
+std::atomic<bool> Profiler::enabled(false);
+
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+static std::mutex buffersMutex;
+static std::vector<ProfileBuffer*> buffers;
+static thread_local ProfileBuffer* threadBuffer = NULL;
+
+static ProfileBuffer* createBuffer(const char* name, bool thread)
+{
+    ProfileBuffer* buffer = new ProfileBuffer();
+    buffer->thread = thread;
+    buffer->head = 0;
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->id = buffers.size() + 1;
+    buffer->name = name ? name : "thread " + std::to_string(buffer->id);
+    // never freed: a thread's zones stay exportable after it exits
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+static void append(ProfileBuffer* buffer, const char* name, unsigned long long start, unsigned long long end)
+{
+    unsigned long long head = buffer->head.load(std::memory_order_relaxed);
+    ProfileEvent &event = buffer->events[head & (Profiler::EVENTS_PER_THREAD - 1)];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::Enable(bool enable)
+{
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    if (!threadBuffer)
+    {
+        threadBuffer = createBuffer(name, true);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    threadBuffer->name = name;
+}
+
+unsigned long long Profiler::Now()
+{
+    // + 1 so a recorded start is never 0, which zones use for "not recording"
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+void Profiler::Record(const char* name, unsigned long long start, unsigned long long end)
+{
+    if (!threadBuffer)
+        threadBuffer = createBuffer(NULL, true);
+    append(threadBuffer, name, start, end);
+}
+
+ProfileBuffer* Profiler::CreateTrack(const char* name)
+{
+    return createBuffer(name, false);
+}
+
+void Profiler::Record(ProfileBuffer* track, const char* name, unsigned long long start, unsigned long long end)
+{
+    append(track, name, start, end);
+}
+
+// ---- EXPORT ----
+
+bool Profiler::WriteChromeTrace(const char* path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char line[256];
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (unsigned int b = 0; b < buffers.size(); b++)
+    {
+        ProfileBuffer* buffer = buffers[b];
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+            << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+        first = false;
+
+        unsigned long long head = buffer->head.load(std::memory_order_acquire);
+        unsigned long long keep = EVENTS_PER_THREAD - EXPORT_MARGIN;
+        for (unsigned long long i = head > keep ? head - keep : 0; i < head; i++)
+        {
+            const ProfileEvent &event = buffer->events[i & (EVENTS_PER_THREAD - 1)];
+            // trace timestamps are microseconds
+            snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     event.name, buffer->id, event.start / 1000.0, (event.end - event.start) / 1000.0);
+            out << line;
+        }
+    }
+    out << "\n]}\n";
+    return true;
+}
+
+unsigned long long Profiler::ZoneCount()
+{
+    unsigned long long count = 0;
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (unsigned int b = 0; b < buffers.size(); b++)
+    {
+        if (buffers[b]->thread)
+            count += buffers[b]->head.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+double Profiler::MeasureZoneCost(unsigned int zones)
+{
+    // the zones go to a scratch ring that is never exported, so the measurement doesn't push real zones out
+    ProfileBuffer* scratch = new ProfileBuffer();
+    scratch->head = 0;
+    ProfileBuffer* recording = threadBuffer;
+    threadBuffer = scratch;
+    bool wasEnabled = Enabled();
+    Enable(true);
+    unsigned long long start = Now();
+    for (unsigned int i = 0; i < zones; i++)
+    {
+        ProfileZone zone("profiler overhead");
+    }
+    unsigned long long elapsed = Now() - start;
+    Enable(wasEnabled);
+    threadBuffer = recording;
+    delete scratch;
+    return zones > 0 ? (double)elapsed / zones : 0.0;
+}
@@ -0,0 +1,208 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+const char* const PROGRAM_CACHE_DIRECTORY = "cache/programs";
+const unsigned int PROGRAM_CACHE_MAGIC = 0x31475250; // "PRG1"
+
+static std::vector<ProgramLoad> loads;
+static unsigned int batchPrograms = 0;
+static double batchWallMs = 0.0;
+static bool batchParallel = false;
+
+// FNV-1a, only has to tell sources apart, not resist anyone
+static unsigned long long hash(unsigned long long h, const std::string &text)
+{
+    for (unsigned int i = 0; i < text.size(); i++)
+    {
+        h ^= (unsigned char)text[i];
+        h *= 0x100000001b3ull;
+    }
+    // a separator, so "ab" + "c" and "a" + "bc" differ
+    h ^= 0xff;
+    h *= 0x100000001b3ull;
+    return h;
+}
+
+static std::string glString(GLenum name)
+{
+    const GLubyte* value = glGetString(name);
+    return value ? (const char*)value : "";
+}
+
+static std::string cachePath(const std::string &key)
+{
+    return std::string(PROGRAM_CACHE_DIRECTORY) + "/" + key + ".bin";
+}
+
+bool ProgramCache::Available()
+{
+    // asked once, there is only the one context
+    static int available = -1;
+    if (available < 0)
+    {
+        // some drivers expose the entry points but no binary format
+        int formats = 0;
+        if (GLAD_GL_VERSION_4_1)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        available = formats > 0;
+    }
+    return available != 0;
+}
+
+std::string ProgramCache::Key(const std::string &vertexSource, const std::string &fragmentSource, const std::string &defines)
+{
+    unsigned long long h = 0xcbf29ce484222325ull;
+    h = hash(h, glString(GL_VENDOR));
+    h = hash(h, glString(GL_RENDERER));
+    h = hash(h, glString(GL_VERSION));
+    h = hash(h, defines);
+    h = hash(h, vertexSource);
+    h = hash(h, fragmentSource);
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", h);
+    return key;
+}
+
+void ProgramCache::PrepareLink(unsigned int program)
+{
+    if (Available())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// ---- DISK CACHE ----
+// header: magic, binary format, binary length
+// then the binary as glGetProgramBinary returned it. Files are written next to their place and renamed
+// over it, so a crash mid-write never leaves a half written entry behind
+
+bool ProgramCache::Load(const std::string &key, unsigned int program)
+{
+    if (!Available())
+        return false;
+    std::ifstream file(cachePath(key).c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    unsigned int header[3];
+    file.read((char*)header, sizeof(header));
+    if (!file || header[0] != PROGRAM_CACHE_MAGIC || header[2] == 0)
+        return false;
+    // the length comes from disk, it has to match what is left of the file before it sizes anything
+    std::streamoff start = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff remaining = file.tellg() - start;
+    file.seekg(start);
+    if (!file || remaining != (std::streamoff)header[2])
+    {
+        std::cout << "ERROR::PROGRAM_CACHE::WRONG_LENGTH " << key << std::endl;
+        return false;
+    }
+    std::vector<char> binary(header[2]);
+    file.read(&binary[0], binary.size());
+    if (!file)
+        return false;
+
+    glProgramBinary(program, header[1], &binary[0], binary.size());
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // the driver changed in a way the key can't see, the caller compiles and overwrites the file
+        std::cout << "ERROR::PROGRAM_CACHE::BINARY_REJECTED " << key << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ProgramCache::Store(const std::string &key, unsigned int program)
+{
+    if (!Available())
+        return;
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+    std::error_code error;
+    std::filesystem::create_directories(PROGRAM_CACHE_DIRECTORY, error);
+    std::string path = cachePath(key);
+    std::string temporary = path + ".tmp";
+    std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "ERROR::PROGRAM_CACHE::NOT_WRITTEN " << path << std::endl;
+        return;
+    }
+    unsigned int header[3] = { PROGRAM_CACHE_MAGIC, format, (unsigned int)length };
+    file.write((const char*)header, sizeof(header));
+    file.write(&binary[0], length);
+    file.close();
+    if (!file)
+    {
+        std::cout << "ERROR::PROGRAM_CACHE::NOT_WRITTEN " << path << std::endl;
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+    // replaces an old entry in one step, readers see the old file or the new one
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        std::cout << "ERROR::PROGRAM_CACHE::NOT_WRITTEN " << path << std::endl;
+        std::filesystem::remove(temporary, error);
+    }
+}
+
+// ---- STATS ----
+
+void ProgramCache::Record(const std::string &name, bool fromCache, double ms)
+{
+    ProgramLoad load;
+    load.name = name;
+    load.fromCache = fromCache;
+    load.ms = ms;
+    loads.push_back(load);
+}
+
+void ProgramCache::RecordBatch(unsigned int programs, double wallMs, bool parallel)
+{
+    batchPrograms = programs;
+    batchWallMs = wallMs;
+    batchParallel = parallel;
+}
+
+const std::vector<ProgramLoad> &ProgramCache::Loads()
+{
+    return loads;
+}
+
+void ProgramCache::WriteStatsJson(std::ostream &out)
+{
+    double compileMs = 0.0;
+    double cacheMs = 0.0;
+    unsigned int hits = 0;
+    out << "{\"programs\":[";
+    for (unsigned int i = 0; i < loads.size(); i++)
+    {
+        out << (i > 0 ? "," : "") << "{\"name\":\"" << loads[i].name << "\",\"source\":\""
+            << (loads[i].fromCache ? "cache" : "compile") << "\",\"ms\":" << loads[i].ms << "}";
+        if (loads[i].fromCache)
+        {
+            cacheMs += loads[i].ms;
+            hits++;
+        }
+        else
+            compileMs += loads[i].ms;
+    }
+    out << "],\"cacheHits\":" << hits
+        << ",\"compiled\":" << loads.size() - hits
+        << ",\"cacheLoadMs\":" << cacheMs
+        << ",\"compileMs\":" << compileMs
+        << ",\"batch\":{\"programs\":" << batchPrograms << ",\"wallMs\":" << batchWallMs
+        << ",\"parallel\":" << (batchParallel ? "true" : "false") << "}}";
+}
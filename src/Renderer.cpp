@@ -0,0 +1,391 @@
+#include "Renderer.h"
+#include "GLState.h"
+#include "GpuProfiler.h"
+#include "MemoryTracker.h"
+#include "Model.h"
+#include "ProgramCache.h"
+#include "TransformMath.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+static const float CUBE_VERTICES[] = {
+    // float3 position, float2 texCoord, float3 normal
+    // front
+    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
+     0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f, 0.0f, -1.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f, 0.0f, -1.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f, 0.0f, -1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
+    // back
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+    // left
+    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  1.0f, 1.0f, -1.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, -1.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, -1.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, -1.0f, 0.0f, 0.0f,
+    // right
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    // bottom
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f, -1.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,  1.0f, 1.0f, 0.0f, -1.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 0.0f, -1.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, 0.0f, -1.0f, 0.0f,
+    // top
+    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f, 1.0f, 0.0f
+};
+
+Renderer::Renderer(JobSystem &jobs, const RendererSettings &settings)
+    : settings(settings),
+      basicShaders("src/basic_vertex.vs", "src/basic_fragment.fs"),
+      lightShader("src/light_vertex.vs", "src/light_fragment.fs"),
+      clusteredShaders("src/basic_vertex.vs", "src/clustered_fragment.fs"),
+      // glyphs are rasterized on first use, nothing is paid here for characters that never show up
+      font("./fonts/NotoMono-Regular.ttf", settings.fontMode),
+      text(font, settings.benchText ? TEXT_BENCH_LABELS * 16 : 4096),
+      // per-frame, lighting, material and object blocks for every program go through this one ring
+      frameUniforms(32 * 1024),
+      clusters(jobs),
+      backpack(NULL),
+      shaderWatcher(NULL),
+      benchLayoutMs(0.0), benchFlushMs(0.0), benchFrames(0),
+      timedPath(SHADING_FORWARD), clusterBinMs(0.0), clusterUploadMs(0.0), clusterFrames(0),
+      lastTimingReport(0.0f), lastStatsReport(0.0f), lastTextReport(0.0f), lastClusterReport(0.0f),
+      targetFramebuffer(0)
+{
+    PROFILE_ZONE("Renderer setup");
+    frameTimeLabel = text.CreateLabel();
+    for (int i = 0; settings.benchText && i < TEXT_BENCH_LABELS; i++)
+        benchLabels.push_back(text.CreateLabel());
+    benchStrings.resize(benchLabels.size());
+
+    glGenVertexArrays(1, &cubeVAO);
+    GLState::BindVertexArray(cubeVAO);
+
+    glGenBuffers(1, &cubeVBO);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, cubeVBO, MEMORY_GEOMETRY, sizeof(CUBE_VERTICES), "light cube");
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    glGenVertexArrays(1, &lightCubeVAO);
+    GLState::BindVertexArray(lightCubeVAO);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
+    glEnableVertexAttribArray(0);
+
+    GLState::Enable(GL_DEPTH_TEST);
+    if (settings.hotReload && Shader::CanReload())
+        shaderWatcher = new ShaderWatcher("src");
+    else if (settings.hotReload)
+        std::cout << "hot reload off: the driver has no KHR_parallel_shader_compile, compiling would block the render thread" << std::endl;
+}
+
+Renderer::~Renderer()
+{
+    delete backpack;
+    delete shaderWatcher;
+    GLState::ForgetVertexArray(cubeVAO);
+    GLState::ForgetVertexArray(lightCubeVAO);
+    glDeleteVertexArrays(1, &cubeVAO);
+    glDeleteVertexArrays(1, &lightCubeVAO);
+    GLState::ForgetBuffer(cubeVBO);
+    MemoryTracker::Release(KIND_BUFFER, cubeVBO);
+    glDeleteBuffers(1, &cubeVBO);
+}
+
+// ---- STARTUP ----
+
+Model* Renderer::ParseBackpack()
+{
+    return new Model("assets/backpack/backpack.obj");
+}
+
+void Renderer::DecodeBackpack(Model* model, JobSystem &jobs)
+{
+    model->DecodeTextures(jobs);
+}
+
+void Renderer::SetBackpack(Model* model)
+{
+    model->Upload();
+    backpack = model;
+    backpackFeatures = backpack->MaterialFeatures();
+    // the forward path is drawn first, its variants join the batch instead of compiling on the first frame
+    for (unsigned int i = 0; i < backpackFeatures.size(); i++)
+        basicShaders.Get(backpackFeatures[i]);
+    shaderBatch.Finish();
+    if (settings.shaderStats)
+    {
+        ProgramCache::WriteStatsJson(std::cout);
+        std::cout << std::endl;
+    }
+}
+
+void Renderer::RenderFrame(const FramePacket &packet)
+{
+    PROFILE_ZONE("RenderFrame");
+    // between frames no draw is using the programs that get swapped
+    if (shaderWatcher)
+        reloadShaders();
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    GLState::Viewport(0, 0, packet.screenWidth, packet.screenHeight);
+    glClearColor(packet.ambientLight.x, packet.ambientLight.y, packet.ambientLight.z, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // ---- SHARED UNIFORM BLOCKS ----
+    frameUniforms.BeginFrame();
+    // every scene shader reads both blocks, without them the scene is skipped for this frame
+    bool sharedBlocks = true;
+    {
+        PROFILE_ZONE("uniform setup");
+        sharedBlocks = frameUniforms.PushBlock(PER_FRAME_BINDING, packet.perFrame);
+
+        // the deferred path draws its lights as volumes and the clustered one reads them from its own buffers,
+        // only the forward path reads them from the block
+        LightingBlock lighting;
+        lighting.lightPos = packet.lightPos;
+        lighting.lightColor = packet.lightColor;
+        lighting.ambientLight = packet.ambientLight;
+        lighting.pointLightCount = 0;
+        if (packet.shadingPath == SHADING_FORWARD)
+        {
+            lighting.pointLightCount = packet.pointLights.size() < MAX_FORWARD_LIGHTS ? packet.pointLights.size() : MAX_FORWARD_LIGHTS;
+            for (int i = 0; i < lighting.pointLightCount; i++)
+                lighting.pointLights[i] = packet.pointLights[i];
+        }
+        sharedBlocks = frameUniforms.PushBlock(LIGHTING_BINDING, lighting) && sharedBlocks;
+        // the material block is bound by each model as it draws, its materials never change
+    }
+
+    if (sharedBlocks)
+        drawScene(packet);
+    drawText(packet);
+
+    // END RENDERING
+    frameUniforms.EndFrame();
+    GLState::EndFrame();
+    if (settings.glStats && packet.time - lastStatsReport >= 1.0f)
+    {
+        std::cout << "{\"state\":";
+        GLState::WriteStatsJson(std::cout);
+        std::cout << ",\"uniformStream\":";
+        frameUniforms.Stream().WriteStatsJson(std::cout);
+        std::cout << "}" << std::endl;
+        lastStatsReport = packet.time;
+    }
+}
+
+void Renderer::SetTarget(unsigned int framebuffer)
+{
+    targetFramebuffer = framebuffer;
+}
+
+// ---- SHADER HOT RELOAD ----
+// a changed file starts a rebuild of every program made from it, the swap happens on a later frame once the
+// driver is done, so editing a shader never stalls a frame on the compiler
+void Renderer::reloadShaders()
+{
+    PROFILE_ZONE("shader reload");
+    shaderChanges.clear();
+    shaderWatcher->Poll(shaderChanges);
+    const std::vector<Shader*> &shaders = Shader::All();
+    for (unsigned int i = 0; i < shaderChanges.size(); i++)
+    {
+        for (unsigned int j = 0; j < shaders.size(); j++)
+        {
+            if (shaders[j]->UsesFile(shaderChanges[i].path))
+                shaders[j]->BeginReload(shaderChanges[i].time);
+        }
+    }
+    for (unsigned int i = 0; i < shaders.size(); i++)
+    {
+        double latencyMs = 0.0;
+        if (shaders[i]->PollReload(latencyMs) == RELOAD_SWAPPED)
+            std::cout << "{\"shaderReload\":\"" << shaders[i]->Name() << "\",\"latencyMs\":" << latencyMs << "}" << std::endl;
+    }
+}
+
+void Renderer::drawScene(const FramePacket &packet)
+{
+    const PointLight* pointLights = packet.pointLights.empty() ? NULL : &packet.pointLights[0];
+    unsigned int pointLightCount = packet.pointLights.size();
+
+    if (packet.shadingPath != timedPath)
+    {
+        // samples of the other path would skew the average
+        scenePassTimer.Reset();
+        timedPath = packet.shadingPath;
+    }
+    // false when the light lists didn't fit in the cluster stream, the backpacks are skipped then
+    bool clustersBuilt = true;
+    if (packet.shadingPath == SHADING_CLUSTERED)
+    {
+        // binning is CPU work, done before the GPU timer starts
+        clustersBuilt = clusters.Build(pointLights, pointLightCount, packet.perFrame.view, packet.perFrame.projection,
+                       packet.screenWidth, packet.screenHeight);
+        if (settings.clusterStats)
+            reportClusters(packet);
+    }
+    if (settings.gpuTiming)
+        scenePassTimer.Begin();
+    {
+        PROFILE_ZONE("scene pass");
+        PROFILE_GPU_ZONE("scene pass");
+        ShaderPermutations &sceneShaders = packet.shadingPath == SHADING_DEFERRED ? deferred.GeometryShaders()
+                                         : packet.shadingPath == SHADING_CLUSTERED ? clusteredShaders : basicShaders;
+        if (packet.shadingPath == SHADING_DEFERRED)
+            deferred.BeginGeometry(packet.screenWidth, packet.screenHeight);
+        if (packet.shadingPath == SHADING_CLUSTERED)
+        {
+            // the cluster uniforms change every frame, each variant the backpack draws with needs them
+            for (unsigned int i = 0; i < backpackFeatures.size(); i++)
+            {
+                Shader &shader = clusteredShaders.Get(backpackFeatures[i]);
+                shader.Use();
+                clusters.Bind(shader);
+            }
+        }
+        for (unsigned int i = 0; i < packet.draws.size(); i++)
+        {
+            if (packet.draws[i].mesh != MESH_BACKPACK || !clustersBuilt)
+                continue;
+            if (!frameUniforms.PushBlock(OBJECT_BINDING, packet.draws[i].object))
+                continue;
+            backpack->Draw(sceneShaders);
+        }
+    }
+    if (packet.shadingPath == SHADING_DEFERRED)
+    {
+        PROFILE_ZONE("deferred lighting");
+        PROFILE_GPU_ZONE("deferred lighting");
+        deferred.Light(pointLights, pointLightCount, targetFramebuffer);
+    }
+    else if (packet.shadingPath == SHADING_CLUSTERED)
+        clusters.EndFrame();
+    if (settings.gpuTiming)
+    {
+        scenePassTimer.End();
+        scenePassTimer.Poll();
+        if (packet.time - lastTimingReport >= 1.0f)
+        {
+            std::cout << SHADING_PATH_NAMES[packet.shadingPath] << " scene pass, " << pointLightCount << " lights: "
+                      << scenePassTimer.AverageMs() << " ms GPU (" << scenePassTimer.Samples() << " frames)" << std::endl;
+            scenePassTimer.Reset();
+            lastTimingReport = packet.time;
+        }
+    }
+
+    // DRAW LIGHT CUBE
+    PROFILE_ZONE("light cubes");
+    PROFILE_GPU_ZONE("light cubes");
+    lightShader.Use();
+    GLState::BindVertexArray(lightCubeVAO);
+    for (unsigned int i = 0; i < packet.draws.size(); i++)
+    {
+        if (packet.draws[i].mesh != MESH_LIGHT_CUBE)
+            continue;
+        if (!frameUniforms.PushBlock(OBJECT_BINDING, packet.draws[i].object))
+            continue;
+        GLState::DrawArrays(GL_TRIANGLES, 0, 36);
+    }
+}
+
+void Renderer::drawText(const FramePacket &packet)
+{
+    PROFILE_ZONE("text");
+    PROFILE_GPU_ZONE("text");
+    font.BeginFrame();
+    text.BeginFrame(packet.screenWidth, packet.screenHeight);
+    if (settings.benchText)
+    {
+        // the strings are built outside the timed part, only layout and vertex writes are measured
+        for (int i = 0; i < TEXT_BENCH_LABELS; i++)
+            benchStrings[i] = "label " + std::to_string(i) + ": " + std::to_string((packet.frameNumber + i) % 10000);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int columns = packet.screenWidth / 128 > 0 ? packet.screenWidth / 128 : 1;
+        for (int i = 0; i < TEXT_BENCH_LABELS; i++)
+        {
+            glm::vec2 position((i % columns) * 128.0f, (float)((i / columns) * 10 % packet.screenHeight));
+            text.Label(benchLabels[i], benchStrings[i], position, 10, glm::vec4(1.0f));
+        }
+        std::chrono::steady_clock::time_point laidOut = std::chrono::steady_clock::now();
+        text.Flush();
+        std::chrono::steady_clock::time_point flushed = std::chrono::steady_clock::now();
+
+        benchLayoutMs += std::chrono::duration<double, std::milli>(laidOut - start).count();
+        benchFlushMs += std::chrono::duration<double, std::milli>(flushed - laidOut).count();
+        benchFrames++;
+        if (packet.time - lastTextReport >= 1.0f)
+        {
+            const TextStats &stats = text.LastFrame();
+            std::cout << "{\"labels\":" << stats.labels
+                      << ",\"layoutMs\":" << benchLayoutMs / benchFrames
+                      << ",\"flushMs\":" << benchFlushMs / benchFrames
+                      << ",\"runsLaidOut\":" << stats.runsLaidOut
+                      << ",\"runsReused\":" << stats.runsReused
+                      << ",\"quads\":" << stats.quads
+                      << ",\"drawCalls\":" << stats.drawCalls << "}" << std::endl;
+            benchLayoutMs = 0.0;
+            benchFlushMs = 0.0;
+            benchFrames = 0;
+            lastTextReport = packet.time;
+        }
+    }
+    else
+    {
+        // only laid out again when the printed value changes
+        char frameTime[32];
+        snprintf(frameTime, sizeof(frameTime), "%.1f ms", packet.deltaTime * 1000.0f);
+        text.Label(frameTimeLabel, frameTime, glm::vec2(10.0f, packet.screenHeight - 30.0f), 20, glm::vec4(1.0f));
+        text.Flush();
+    }
+}
+
+void Renderer::reportClusters(const FramePacket &packet)
+{
+    const ClusterStats &stats = clusters.LastFrame();
+    clusterBinMs += stats.binMs;
+    clusterUploadMs += stats.uploadMs;
+    clusterFrames++;
+    if (packet.time - lastClusterReport >= 1.0f)
+    {
+        std::cout << "{\"lights\":" << stats.lights
+                  << ",\"binMs\":" << clusterBinMs / clusterFrames
+                  << ",\"uploadMs\":" << clusterUploadMs / clusterFrames
+                  << ",\"indices\":" << stats.indices
+                  << ",\"maxLightsPerCluster\":" << stats.maxLightsPerCluster << "}" << std::endl;
+        clusterBinMs = 0.0;
+        clusterUploadMs = 0.0;
+        clusterFrames = 0;
+        lastClusterReport = packet.time;
+    }
+}
@@ -0,0 +1,273 @@
+#include "SdfGenerator.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+
+// FT_RENDER_MODE_SDF arrived with FreeType 2.11
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define HAS_FT_SDF
+#endif
+
+const char* const SDF_CACHE_DIRECTORY = "cache/fonts";
+const unsigned int SDF_CACHE_MAGIC = 0x31464453; // "SDF1"
+
+// FNV-1a of the font file's bytes, an edited font or another font of the same name gets a cache of its own
+static std::string fontHash(const char* fontPath)
+{
+    unsigned long long h = 0xcbf29ce484222325ull;
+    std::ifstream file(fontPath, std::ios::binary);
+    char buffer[64 * 1024];
+    while (file)
+    {
+        file.read(buffer, sizeof(buffer));
+        std::streamsize read = file.gcount();
+        for (std::streamsize i = 0; i < read; i++)
+        {
+            h ^= (unsigned char)buffer[i];
+            h *= 0x100000001b3ull;
+        }
+    }
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", h);
+    return key;
+}
+
+SdfGenerator::SdfGenerator(const char* fontPath, unsigned int rasterSize, unsigned int spread, unsigned int threads)
+    : RasterSize(rasterSize), Spread(spread), fontPath(fontPath), cacheDirty(false), stopping(false)
+{
+    std::filesystem::path font(fontPath);
+    cachePath = std::string(SDF_CACHE_DIRECTORY) + "/" + font.stem().string() + "_" + fontHash(fontPath) + "_sdf" +
+                std::to_string(rasterSize) + "_" + std::to_string(spread) + ".bin";
+    loadCache();
+
+    if (threads == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned int i = 0; i < threads; i++)
+        workers.push_back(std::thread(&SdfGenerator::work, this));
+}
+
+SdfGenerator::~SdfGenerator()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    // glyphs finished after the last Collect() are still worth keeping
+    std::vector<SdfGlyph> finished;
+    Collect(finished);
+    SaveCache();
+}
+
+bool SdfGenerator::Request(unsigned int codepoint, SdfGlyph &glyph)
+{
+    std::unordered_map<unsigned int, SdfGlyph>::iterator it = cache.find(codepoint);
+    if (it != cache.end())
+    {
+        glyph = it->second;
+        return true;
+    }
+
+    if (pending.insert(codepoint).second)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(codepoint);
+        wake.notify_one();
+    }
+    return false;
+}
+
+void SdfGenerator::Collect(std::vector<SdfGlyph> &finished)
+{
+    std::vector<SdfGlyph> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(results);
+    }
+
+    for (unsigned int i = 0; i < done.size(); i++)
+    {
+        pending.erase(done[i].codepoint);
+        cache[done[i].codepoint] = done[i];
+        cacheDirty = true;
+        finished.push_back(std::move(done[i]));
+    }
+}
+
+void SdfGenerator::work()
+{
+    FT_Library library;
+    FT_Face face = NULL;
+    if (FT_Init_FreeType(&library))
+    {
+        std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+        library = NULL;
+    }
+    else if (FT_New_Face(library, fontPath.c_str(), 0, &face))
+    {
+        std::cout << "ERROR::FREETYPE: failed to load font" << std::endl;
+        face = NULL;
+    }
+    else
+    {
+#ifdef HAS_FT_SDF
+        FT_Int spread = Spread;
+        FT_Property_Set(library, "sdf", "spread", &spread);
+#endif
+        FT_Set_Pixel_Sizes(face, 0, RasterSize);
+    }
+
+    while (true)
+    {
+        unsigned int codepoint;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping)
+                break;
+            codepoint = requests.front();
+            requests.pop_front();
+        }
+
+        // a glyph that can't be generated still comes back, empty, so it stops being pending
+        SdfGlyph glyph;
+        glyph.codepoint = codepoint;
+        glyph.size = glm::ivec2(0);
+        glyph.bearing = glm::ivec2(0);
+        glyph.advance = 0;
+
+#ifdef HAS_FT_SDF
+        if (face && !FT_Load_Char(face, codepoint, FT_LOAD_DEFAULT))
+        {
+            glyph.advance = (unsigned int)face->glyph->advance.x;
+            // whitespace has no outline to measure a distance to
+            if (face->glyph->outline.n_points > 0 && !FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF))
+            {
+                FT_Bitmap &bitmap = face->glyph->bitmap;
+                glyph.size = glm::ivec2(bitmap.width, bitmap.rows);
+                glyph.bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+                glyph.pixels.resize(bitmap.width * bitmap.rows);
+                for (unsigned int row = 0; row < bitmap.rows; row++)
+                    memcpy(&glyph.pixels[row * bitmap.width], bitmap.buffer + row * bitmap.pitch, bitmap.width);
+            }
+        }
+#else
+        std::cout << "ERROR::FREETYPE: SDF glyphs need FreeType 2.11 or newer" << std::endl;
+#endif
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(glyph));
+    }
+
+    if (face)
+        FT_Done_Face(face);
+    if (library)
+        FT_Done_FreeType(library);
+}
+
+// ---- DISK CACHE ----
+// header: magic, raster size, spread, glyph count
+// glyph:  codepoint, width, height, bearing x, bearing y, advance, width * height distance bytes
+// The file is written next to its place and renamed over it, so a crash mid-write never leaves a half
+// written cache behind. A record larger than a glyph can be, or than what is left of the file, ends the load
+
+void SdfGenerator::loadCache()
+{
+    std::ifstream file(cachePath.c_str(), std::ios::binary);
+    if (!file)
+        return;
+
+    file.seekg(0, std::ios::end);
+    std::streamoff remaining = file.tellg();
+    file.seekg(0);
+
+    unsigned int header[4];
+    file.read((char*)header, sizeof(header));
+    if (!file || header[0] != SDF_CACHE_MAGIC || header[1] != RasterSize || header[2] != Spread)
+        return;
+    remaining -= sizeof(header);
+
+    // a glyph's distance field is the raster size at most, plus the spread on either side
+    int maxSide = (int)(RasterSize + 2 * Spread);
+    for (unsigned int i = 0; i < header[3]; i++)
+    {
+        int record[6];
+        file.read((char*)record, sizeof(record));
+        remaining -= sizeof(record);
+        if (!file || record[1] < 0 || record[2] < 0 || record[1] > maxSide || record[2] > maxSide ||
+            (std::streamoff)record[1] * record[2] > remaining)
+        {
+            std::cout << "ERROR::SDF::CACHE_CORRUPT " << cachePath << std::endl;
+            break;
+        }
+        remaining -= (std::streamoff)record[1] * record[2];
+
+        SdfGlyph glyph;
+        glyph.codepoint = (unsigned int)record[0];
+        glyph.size = glm::ivec2(record[1], record[2]);
+        glyph.bearing = glm::ivec2(record[3], record[4]);
+        glyph.advance = (unsigned int)record[5];
+        glyph.pixels.resize(record[1] * record[2]);
+        if (!glyph.pixels.empty())
+            file.read((char*)&glyph.pixels[0], glyph.pixels.size());
+        if (!file)
+            break;
+        cache[glyph.codepoint] = glyph;
+    }
+}
+
+void SdfGenerator::SaveCache()
+{
+    if (!cacheDirty)
+        return;
+
+    std::error_code error;
+    std::filesystem::create_directories(SDF_CACHE_DIRECTORY, error);
+    std::string temporary = cachePath + ".tmp";
+    std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "ERROR::SDF::CACHE_NOT_WRITTEN " << cachePath << std::endl;
+        return;
+    }
+
+    unsigned int header[4] = { SDF_CACHE_MAGIC, RasterSize, Spread, (unsigned int)cache.size() };
+    file.write((const char*)header, sizeof(header));
+    for (std::unordered_map<unsigned int, SdfGlyph>::const_iterator it = cache.begin(); it != cache.end(); ++it)
+    {
+        const SdfGlyph &glyph = it->second;
+        int record[6] = { (int)glyph.codepoint, glyph.size.x, glyph.size.y, glyph.bearing.x, glyph.bearing.y, (int)glyph.advance };
+        file.write((const char*)record, sizeof(record));
+        if (!glyph.pixels.empty())
+            file.write((const char*)&glyph.pixels[0], glyph.pixels.size());
+    }
+    file.close();
+    if (!file)
+    {
+        std::cout << "ERROR::SDF::CACHE_NOT_WRITTEN " << cachePath << std::endl;
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+    // replaces the old cache in one step
+    std::filesystem::rename(temporary, cachePath, error);
+    if (error)
+    {
+        std::cout << "ERROR::SDF::CACHE_NOT_WRITTEN " << cachePath << std::endl;
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+    cacheDirty = false;
+}
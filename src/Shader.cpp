@@ -1,81 +1,559 @@
 #include "Shader.h"
+#include "Material.h"
+#include "UniformBuffer.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include "ProgramCache.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <thread>
+
+// KHR_parallel_shader_compile, glad is generated without extensions
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// deeper than this is taken for an include cycle
+const int MAX_INCLUDE_DEPTH = 16;
+
+static std::vector<Shader*> shaders;
+// path -> text, filled by PrefetchSources
+static std::map<std::string, std::string> prefetched;
+
+// ---- STARTUP BATCH ----
+// programs submitted while a batch is open and not checked yet
+static bool batchOpen = false;
+static std::vector<Shader*> batch;
+static std::chrono::steady_clock::time_point batchStart;
+
+// glMaxShaderCompilerThreadsKHR/ARB, loaded by hand since glad has no extensions
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+static MaxShaderCompilerThreadsProc maxShaderCompilerThreads = NULL;
+
+// asked once, there is only the one context
+static bool parallelCompile()
 {
-    // ---- READ FILES ----
-    std::string vertexString;
-    std::string fragmentString;
-    std::fstream vertexFileStream;
-    std::fstream fragmentFileStream;
-    vertexFileStream.exceptions(std::fstream::failbit | std::fstream::badbit);
-    fragmentFileStream.exceptions(std::fstream::failbit | std::fstream::badbit);
-    try
+    static int supported = -1;
+    if (supported < 0)
     {
-        vertexFileStream.open(vertexPath);
-        fragmentFileStream.open(fragmentPath);
-        std::stringstream vertexStringStream;
-        std::stringstream fragmentStringStream;
-        vertexStringStream << vertexFileStream.rdbuf();
-        fragmentStringStream << fragmentFileStream.rdbuf();
-        vertexString = vertexStringStream.str();
-        fragmentString = fragmentStringStream.str();
+        supported = 0;
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (int i = 0; i < count; i++)
+        {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0)
+                supported = 1;
+        }
     }
-    catch(std::ifstream::failure e)
+    return supported != 0;
+}
+
+static void leaveBatch(Shader* shader)
+{
+    for (unsigned int i = 0; i < batch.size(); i++)
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+        if (batch[i] == shader)
+        {
+            batch.erase(batch.begin() + i);
+            return;
+        }
     }
+}
 
-    const char* vertexShaderSource = vertexString.c_str();
-    const char* fragmentShaderSource = fragmentString.c_str();
-
-    // --- VERTEX SHADER ----
-    unsigned int vertexShader;
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
+static unsigned int compileStage(GLenum type, const std::string &source)
+{
+    const char* text = source.c_str();
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    return shader;
+}
 
+// prints the log of a stage that failed, true when it compiled. The log gives source string numbers,
+// files lists them in that order
+static bool checkStage(unsigned int shader, const char* stageName, const std::vector<std::string> &files)
+{
     int success;
     char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if(!success)
     {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n" << infoLog;
+        for (unsigned int i = 0; i < files.size(); i++)
+            std::cout << (i == 0 ? "sources: " : ", ") << i << " " << files[i];
+        std::cout << std::endl;
     }
+    return success != 0;
+}
 
-    // ---- FRAGMENT SHADER ----
-    unsigned int fragmentShader;
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
+static bool readFile(const std::string &path, std::string &text)
+{
+    std::map<std::string, std::string>::const_iterator found = prefetched.find(path);
+    if (found != prefetched.end())
+    {
+        text = found->second;
+        return true;
+    }
+    std::ifstream fileStream;
+    fileStream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try
+    {
+        fileStream.open(path.c_str());
+        std::stringstream stringStream;
+        stringStream << fileStream.rdbuf();
+        text = stringStream.str();
+    }
+    catch(std::ifstream::failure &e)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if(!success)
+// ---- PREPROCESSOR ----
+// pastes #include "file" lines in place, the name is relative to the including file. A file is pasted
+// once per stage, so shared blocks can be included from several includes. #line directives keep the
+// compiler's line numbers pointing into the right file, the source string number is its index in files
+static bool expandIncludes(const std::string &path, std::string &out, std::vector<std::string> &files, int depth)
+{
+    std::string text;
+    if (!readFile(path, text))
+        return false;
+    unsigned int fileIndex = files.size();
+    files.push_back(path);
+    std::string directory = path.find('/') == std::string::npos ? "" : path.substr(0, path.find_last_of('/') + 1);
+
+    std::istringstream lines(text);
+    std::string line;
+    for (unsigned int lineNumber = 1; std::getline(lines, line); lineNumber++)
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        {
+            out += line + "\n";
+            continue;
+        }
+
+        size_t open = line.find('"', start);
+        size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        if (close == std::string::npos)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_MALFORMED " << path << ":" << lineNumber << std::endl;
+            return false;
+        }
+        if (depth >= MAX_INCLUDE_DEPTH)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << ":" << lineNumber << std::endl;
+            return false;
+        }
+        std::string included = directory + line.substr(open + 1, close - open - 1);
+        bool pasted = false;
+        for (unsigned int i = 0; i < files.size() && !pasted; i++)
+            pasted = files[i] == included;
+        if (!pasted)
+        {
+            out += "#line 1 " + std::to_string(files.size()) + "\n";
+            if (!expandIncludes(included, out, files, depth + 1))
+                return false;
+        }
+        out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
     }
+    return true;
+}
 
-    // ---- SHADER PROGRAM ----
+// the defines go right after #version, which has to stay the first line
+static std::string insertDefines(const std::string &source, const std::string &defines)
+{
+    if (defines.empty())
+        return source;
+    size_t version = source.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return defines + source;
+    // the main file is source string 0, the line after #version keeps its number
+    unsigned int versionLine = 1;
+    for (size_t i = 0; i < lineEnd; i++)
+        versionLine += source[i] == '\n';
+    return source.substr(0, lineEnd + 1) + defines + "#line " + std::to_string(versionLine + 1) + " 0\n" + source.substr(lineEnd + 1);
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string &defines)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines),
+      linkVertex(0), linkFragment(0),
+      pendingID(0), pendingVertex(0), pendingFragment(0)
+{
+    PROFILE_ZONE("Shader load");
+    linkStart = std::chrono::steady_clock::now();
+    shaders.push_back(this);
+    std::string vertexString;
+    std::string fragmentString;
+    readSources(vertexString, fragmentString);
+
+    // ---- PROGRAM BINARY CACHE ----
     ID = glCreateProgram();
-    glAttachShader(ID, vertexShader);
-    glAttachShader(ID, fragmentShader);
+    cacheKey = ProgramCache::Key(vertexString, fragmentString, defines);
+    if (ProgramCache::Load(cacheKey, ID))
+    {
+        bindUniformBlocks();
+        bindMaterialSamplers();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - linkStart).count();
+        ProgramCache::Record(Name(), true, ms);
+        return;
+    }
+
+    // a rejected binary may have left the program in a failed state, start over
+    glDeleteProgram(ID);
+    ID = glCreateProgram();
+    submitLink(vertexString, fragmentString);
+    if (batchOpen)
+        batch.push_back(this);
+    else
+        finishLink();
+}
+
+Shader::~Shader()
+{
+    for (unsigned int i = 0; i < shaders.size(); i++)
+    {
+        if (shaders[i] == this)
+        {
+            shaders.erase(shaders.begin() + i);
+            break;
+        }
+    }
+    leaveBatch(this);
+    if (linkVertex != 0)
+        glDeleteShader(linkVertex);
+    if (linkFragment != 0)
+        glDeleteShader(linkFragment);
+    deletePending();
+    GLState::ForgetProgram(ID);
+    glDeleteProgram(ID);
+}
+
+bool Shader::readSources(std::string &vertexString, std::string &fragmentString)
+{
+    std::string vertexText;
+    std::string fragmentText;
+    std::vector<std::string> newVertexFiles;
+    std::vector<std::string> newFragmentFiles;
+    if (!expandIncludes(vertexPath, vertexText, newVertexFiles, 0) || !expandIncludes(fragmentPath, fragmentText, newFragmentFiles, 0))
+        return false;
+    vertexString = insertDefines(vertexText, defines);
+    fragmentString = insertDefines(fragmentText, defines);
+    vertexFiles = newVertexFiles;
+    fragmentFiles = newFragmentFiles;
+    return true;
+}
+
+// compile and link are only issued here, any status query would make the driver finish them first
+void Shader::submitLink(const std::string &vertexString, const std::string &fragmentString)
+{
+    // --- VERTEX SHADER ----
+    linkVertex = compileStage(GL_VERTEX_SHADER, vertexString);
+
+    // ---- FRAGMENT SHADER ----
+    linkFragment = compileStage(GL_FRAGMENT_SHADER, fragmentString);
+
+    // ---- SHADER PROGRAM ----
+    glAttachShader(ID, linkVertex);
+    glAttachShader(ID, linkFragment);
+    ProgramCache::PrepareLink(ID);
     glLinkProgram(ID);
+}
 
+void Shader::finishLink()
+{
+    // the compile logs are only worth reading when the link failed
+    int success;
+    char infoLog[512];
     glGetProgramiv(ID, GL_LINK_STATUS, &success);
     if (!success)
     {
+        checkStage(linkVertex, "VERTEX", vertexFiles);
+        checkStage(linkFragment, "FRAGMENT", fragmentFiles);
         glGetProgramInfoLog(ID, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
+    else
+        ProgramCache::Store(cacheKey, ID);
+
+    glDeleteShader(linkVertex);
+    glDeleteShader(linkFragment);
+    linkVertex = 0;
+    linkFragment = 0;
+    bindUniformBlocks();
+    bindMaterialSamplers();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - linkStart).count();
+    ProgramCache::Record(Name(), false, ms);
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+// ---- STARTUP BATCH ----
+
+void Shader::LoadCompilerThreads(GLADloadproc loader)
+{
+    maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+    if (!maxShaderCompilerThreads)
+        maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsARB");
+}
+
+void Shader::PrefetchSources(const std::string &directory)
+{
+    PROFILE_ZONE("Shader::PrefetchSources");
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(directory, error); !error && it != std::filesystem::directory_iterator(); it.increment(error))
+    {
+        std::string extension = it->path().extension().string();
+        if (extension != ".vs" && extension != ".fs" && extension != ".glsl")
+            continue;
+        // keyed the way Shader paths and includes are written
+        std::string path = directory + "/" + it->path().filename().string();
+        std::string text;
+        if (readFile(path, text))
+            prefetched[path] = text;
+    }
+}
+
+void Shader::ClearPrefetched()
+{
+    prefetched.clear();
+}
+
+void Shader::BeginBatch()
+{
+    batchOpen = true;
+    batchStart = std::chrono::steady_clock::now();
+    // 0xFFFFFFFF lets the driver pick as many threads as it likes
+    if (parallelCompile() && maxShaderCompilerThreads)
+        maxShaderCompilerThreads(0xFFFFFFFF);
+}
+
+void Shader::EndBatch()
+{
+    PROFILE_ZONE("Shader batch");
+    batchOpen = false;
+    unsigned int programs = batch.size();
+    // with parallel compile the programs are finished in the order the driver completes them, so each one's
+    // time ends when it was ready; otherwise the first status query waits and the rest are likely done by then
+    while (!batch.empty())
+    {
+        bool finished = false;
+        for (unsigned int i = 0; i < batch.size(); i++)
+        {
+            int done = 1;
+            if (parallelCompile())
+                glGetProgramiv(batch[i]->ID, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                continue;
+            batch[i]->finishLink();
+            batch.erase(batch.begin() + i);
+            finished = true;
+            break;
+        }
+        if (!finished)
+            std::this_thread::yield();
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+    ProgramCache::RecordBatch(programs, wallMs, parallelCompile() && maxShaderCompilerThreads);
+}
+
+// ---- UNIFORM BLOCKS ----
+// attach whichever of the shared blocks this program declares to its fixed binding point, a program
+// loaded from a binary or reloaded starts with the defaults again
+void Shader::bindUniformBlocks()
+{
+    for (unsigned int i = 0; i < UNIFORM_BLOCK_COUNT; i++)
+    {
+        unsigned int blockIndex = glGetUniformBlockIndex(ID, UNIFORM_BLOCK_NAMES[i]);
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, blockIndex, i);
+    }
+}
+
+// the material maps' units are fixed, so they are set once here instead of before every draw
+void Shader::bindMaterialSamplers()
+{
+    for (unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+    {
+        int location = glGetUniformLocation(ID, MATERIAL_MAP_UNIFORMS[map]);
+        if (location < 0)
+            continue;
+        GLState::UseProgram(ID);
+        glUniform1i(location, MATERIAL_TEXTURE_UNIT + map);
+    }
+}
+
+ShaderBatch::ShaderBatch() : open(true)
+{
+    Shader::BeginBatch();
+}
+
+ShaderBatch::~ShaderBatch()
+{
+    Finish();
+}
+
+void ShaderBatch::Finish()
+{
+    if (open)
+        Shader::EndBatch();
+    open = false;
+}
+
+// ---- HOT RELOAD ----
+
+const std::vector<Shader*> &Shader::All()
+{
+    return shaders;
+}
+
+std::string Shader::Name() const
+{
+    // variants of the same files are told apart by their defines
+    std::string name = vertexPath + " + " + fragmentPath;
+    std::istringstream lines(defines);
+    std::string line;
+    std::string defined;
+    while (std::getline(lines, line))
+    {
+        if (line.compare(0, 8, "#define ") == 0)
+            defined += (defined.empty() ? "" : " ") + line.substr(8);
+    }
+    return defined.empty() ? name : name + " [" + defined + "]";
+}
+
+bool Shader::UsesFile(const std::string &path) const
+{
+    for (unsigned int i = 0; i < vertexFiles.size(); i++)
+    {
+        if (vertexFiles[i] == path)
+            return true;
+    }
+    for (unsigned int i = 0; i < fragmentFiles.size(); i++)
+    {
+        if (fragmentFiles[i] == path)
+            return true;
+    }
+    return false;
+}
+
+bool Shader::CanReload()
+{
+    return parallelCompile();
+}
+
+void Shader::BeginReload(std::chrono::steady_clock::time_point requestTime)
+{
+    deletePending();
+    std::string vertexString;
+    std::string fragmentString;
+    // an editor may have truncated the file and not written it yet, the next write event retries
+    if (!readSources(vertexString, fragmentString))
+        return;
+
+    reloadRequest = requestTime;
+    pendingKey = ProgramCache::Key(vertexString, fragmentString, defines);
+    pendingVertex = compileStage(GL_VERTEX_SHADER, vertexString);
+    pendingFragment = compileStage(GL_FRAGMENT_SHADER, fragmentString);
+    pendingID = glCreateProgram();
+    glAttachShader(pendingID, pendingVertex);
+    glAttachShader(pendingID, pendingFragment);
+    ProgramCache::PrepareLink(pendingID);
+    // no status query here, that would wait for the compiler
+    glLinkProgram(pendingID);
+}
+
+ReloadStatus Shader::PollReload(double &latencyMs)
+{
+    if (pendingID == 0)
+        return RELOAD_IDLE;
+    // the only query that doesn't wait for the compiler, the link status below is safe once it says done
+    int done = 0;
+    glGetProgramiv(pendingID, GL_COMPLETION_STATUS_KHR, &done);
+    if (!done)
+        return RELOAD_PENDING;
+
+    int linked = 0;
+    glGetProgramiv(pendingID, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        checkStage(pendingVertex, "VERTEX", vertexFiles);
+        checkStage(pendingFragment, "FRAGMENT", fragmentFiles);
+        char infoLog[512];
+        glGetProgramInfoLog(pendingID, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::RELOAD_FAILED " << Name() << "\n" << infoLog << std::endl;
+        deletePending();
+        return RELOAD_FAILED;
+    }
+
+    unsigned int oldID = ID;
+    copyIntUniforms(oldID, pendingID);
+    ID = pendingID;
+    bindUniformBlocks();
+    bindMaterialSamplers();
+    ProgramCache::Store(pendingKey, ID);
+    pendingID = 0;
+    deletePending();
+    GLState::ForgetProgram(oldID);
+    glDeleteProgram(oldID);
+    latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reloadRequest).count();
+    return RELOAD_SWAPPED;
+}
+
+// samplers and the other ints are set once after creation, everything else is set every frame anyway
+void Shader::copyIntUniforms(unsigned int from, unsigned int to)
+{
+    int count = 0;
+    glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+    GLState::UseProgram(to);
+    for (int i = 0; i < count; i++)
+    {
+        char name[256];
+        int size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(from, i, sizeof(name), NULL, &size, &type, name);
+        bool integer = type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_3D
+                       || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_2D_ARRAY || type == GL_UNSIGNED_INT_SAMPLER_2D
+                       || type == GL_UNSIGNED_INT_SAMPLER_BUFFER || type == GL_SAMPLER_BUFFER;
+        int fromLocation = glGetUniformLocation(from, name);
+        int toLocation = glGetUniformLocation(to, name);
+        // block members have no location
+        if (!integer || fromLocation < 0 || toLocation < 0)
+            continue;
+        int value = 0;
+        glGetUniformiv(from, fromLocation, &value);
+        glUniform1i(toLocation, value);
+    }
+}
+
+void Shader::deletePending()
+{
+    if (pendingID != 0)
+        glDeleteProgram(pendingID);
+    if (pendingVertex != 0)
+        glDeleteShader(pendingVertex);
+    if (pendingFragment != 0)
+        glDeleteShader(pendingFragment);
+    pendingID = 0;
+    pendingVertex = 0;
+    pendingFragment = 0;
 }
 
 void Shader::Use()
 {
-    glUseProgram(ID);
+    // a batched program used before EndBatch is finished now, its blocks and samplers are bound in finishLink
+    if (linkVertex != 0)
+    {
+        leaveBatch(this);
+        finishLink();
+    }
+    GLState::UseProgram(ID);
 }
 
 void Shader::SetBool(const std::string &name, bool value) const
@@ -0,0 +1,33 @@
+#include "ShaderPermutations.h"
+
+const char* const MATERIAL_FEATURE_DEFINES[MATERIAL_FEATURE_COUNT] = {
+    "HAS_SPECULAR_MAP", "HAS_NORMAL_MAP", "HAS_DIFFUSE_MAP"
+};
+
+ShaderPermutations::ShaderPermutations(const char* vertexPath, const char* fragmentPath, const std::string &defines)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
+{
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+    for (std::map<unsigned int, Shader*>::iterator it = variants.begin(); it != variants.end(); ++it)
+        delete it->second;
+}
+
+Shader &ShaderPermutations::Get(unsigned int features)
+{
+    std::map<unsigned int, Shader*>::iterator found = variants.find(features);
+    if (found != variants.end())
+        return *found->second;
+
+    std::string variantDefines = defines;
+    for (unsigned int i = 0; i < MATERIAL_FEATURE_COUNT; i++)
+    {
+        if (features & (1u << i))
+            variantDefines += std::string("#define ") + MATERIAL_FEATURE_DEFINES[i] + "\n";
+    }
+    Shader* shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), variantDefines);
+    variants[features] = shader;
+    return *shader;
+}
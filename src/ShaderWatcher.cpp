@@ -0,0 +1,87 @@
+#include "ShaderWatcher.h"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// how long the watcher thread sleeps between checks for the destructor
+const int WATCH_POLL_MS = 100;
+
+static bool isShaderFile(const std::string &name)
+{
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = name.substr(dot);
+    return extension == ".vs" || extension == ".fs" || extension == ".glsl";
+}
+
+ShaderWatcher::ShaderWatcher(const char* directory) : directory(directory), fd(-1), stopping(false)
+{
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // editors either write in place or write a new file and rename it over the old one
+    if (fd < 0 || inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cout << "ERROR::SHADER_WATCHER::WATCH_FAILED " << directory << std::endl;
+        return;
+    }
+    thread = std::thread(&ShaderWatcher::watch, this);
+#else
+    std::cout << "ERROR::SHADER_WATCHER::UNSUPPORTED" << std::endl;
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    stopping = true;
+    if (thread.joinable())
+        thread.join();
+#ifdef __linux__
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+void ShaderWatcher::Poll(std::vector<ShaderChange> &changes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.insert(changes.end(), pending.begin(), pending.end());
+    pending.clear();
+}
+
+void ShaderWatcher::watch()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    while (!stopping)
+    {
+        pollfd descriptor = { fd, POLLIN, 0 };
+        if (poll(&descriptor, 1, WATCH_POLL_MS) <= 0)
+            continue;
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event* event = (const inotify_event*)(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->len == 0 || !isShaderFile(event->name))
+                continue;
+
+            ShaderChange change;
+            change.path = directory + "/" + event->name;
+            change.time = now;
+            std::lock_guard<std::mutex> lock(mutex);
+            bool known = false;
+            for (unsigned int i = 0; i < pending.size() && !known; i++)
+                known = pending[i].path == change.path;
+            if (!known)
+                pending.push_back(change);
+        }
+    }
+#endif
+}
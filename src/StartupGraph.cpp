@@ -0,0 +1,143 @@
+#include "StartupGraph.h"
+#include "Profiler.h"
+
+#include <fstream>
+#include <iostream>
+
+StartupGraph::StartupGraph(JobSystem &jobs, std::chrono::steady_clock::time_point origin)
+    : jobs(jobs), origin(origin), firstFrameMs(0.0)
+{
+}
+
+StartupGraph::~StartupGraph()
+{
+    for (unsigned int i = 0; i < steps.size(); i++)
+        delete steps[i];
+}
+
+int StartupGraph::Add(const char* name, StartupStepKind kind, const std::function<void()> &work, const std::vector<int> &dependencies)
+{
+    Step* step = new Step();
+    step->graph = this;
+    step->name = name;
+    step->kind = kind;
+    step->work = work;
+    step->waiting = dependencies.size();
+    for (unsigned int i = 0; i < dependencies.size(); i++)
+        steps[dependencies[i]]->dependents.push_back(step);
+    steps.push_back(step);
+    return steps.size() - 1;
+}
+
+void StartupGraph::Run()
+{
+    PROFILE_ZONE("startup");
+    // collected first, a step without dependencies may finish and start others while this loop runs
+    std::vector<Step*> roots;
+    for (unsigned int i = 0; i < steps.size(); i++)
+    {
+        if (steps[i]->waiting == 0)
+            roots.push_back(steps[i]);
+    }
+    for (unsigned int i = 0; i < roots.size(); i++)
+        launch(roots[i]);
+    // thread 0 stays free for the GL steps instead of picking up the CPU steps' jobs
+    jobs.WaitOnMainThread(&counter);
+}
+
+void StartupGraph::launch(Step* step)
+{
+    if (step->kind == STEP_GL)
+        jobs.RunOnMainThread(&StartupGraph::execute, step, &counter);
+    else
+        jobs.Run(&StartupGraph::execute, step, &counter);
+}
+
+void StartupGraph::execute(void* data)
+{
+    Step* step = (Step*)data;
+    StartupGraph* graph = step->graph;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        PROFILE_ZONE(step->name);
+        step->work();
+    }
+    graph->Record(step->name, step->kind == STEP_GL ? "gl thread" : "job threads", start, std::chrono::steady_clock::now());
+
+    // dependents are started before this job returns, so the counter Run() waits on never passes zero early
+    for (unsigned int i = 0; i < step->dependents.size(); i++)
+    {
+        if (step->dependents[i]->waiting.fetch_sub(1) == 1)
+            graph->launch(step->dependents[i]);
+    }
+}
+
+void StartupGraph::Record(const char* name, const char* thread, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    Span span = { name, thread, sinceOrigin(start), sinceOrigin(end) };
+    std::lock_guard<std::mutex> lock(mutex);
+    spans.push_back(span);
+}
+
+void StartupGraph::FirstFrame(std::chrono::steady_clock::time_point time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    firstFrameMs = sinceOrigin(time);
+}
+
+double StartupGraph::TimeToFirstFrameMs() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return firstFrameMs;
+}
+
+double StartupGraph::sinceOrigin(std::chrono::steady_clock::time_point time) const
+{
+    return std::chrono::duration<double, std::milli>(time - origin).count();
+}
+
+// ---- OUTPUT ----
+
+bool StartupGraph::WriteTrace(const char* path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cout << "ERROR::STARTUP::TRACE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    // one track per thread label, the job threads share one since a step doesn't know its worker
+    std::vector<const char*> threads;
+    out << "{\"traceEvents\":[";
+    for (unsigned int i = 0; i < spans.size(); i++)
+    {
+        unsigned int tid = 0;
+        while (tid < threads.size() && std::string(threads[tid]) != spans[i].thread)
+            tid++;
+        if (tid == threads.size())
+        {
+            threads.push_back(spans[i].thread);
+            out << (i > 0 ? "," : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                << ",\"args\":{\"name\":\"" << spans[i].thread << "\"}}";
+        }
+        out << ",{\"name\":\"" << spans[i].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+            << ",\"ts\":" << spans[i].startMs * 1000.0 << ",\"dur\":" << (spans[i].endMs - spans[i].startMs) * 1000.0 << "}";
+    }
+    if (firstFrameMs > 0.0)
+    {
+        out << (spans.empty() ? "" : ",") << "{\"name\":\"first frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":"
+            << firstFrameMs * 1000.0 << "}";
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    return true;
+}
+
+void StartupGraph::WriteStatsJson(std::ostream &out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "{\"timeToFirstFrameMs\":" << firstFrameMs << ",\"steps\":{";
+    for (unsigned int i = 0; i < spans.size(); i++)
+        out << (i > 0 ? "," : "") << "\"" << spans[i].name << "\":" << spans[i].endMs - spans[i].startMs;
+    out << "}}";
+}
@@ -0,0 +1,190 @@
+#include "StreamBuffer.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// how long a single glClientWaitSync may block before it is retried, in nanoseconds
+const GLuint64 FENCE_TIMEOUT = 1000000;
+
+StreamBuffer::StreamBuffer(GLsizeiptr bytesPerFrame, unsigned int framesInFlight, const char* owner)
+{
+    // regions have to start on an offset that is valid for every kind of binding
+    GLsizeiptr alignment = UniformAlignment();
+    frameSize = (bytesPerFrame + alignment - 1) / alignment * alignment;
+    frameCount = framesInFlight < MAX_FRAMES ? framesInFlight : MAX_FRAMES;
+    frameIndex = frameCount - 1;
+    head = 0;
+    mapped = NULL;
+    reportedFull = false;
+    memset(fences, 0, sizeof(fences));
+    memset(&currentFrame, 0, sizeof(currentFrame));
+    memset(&lastFrame, 0, sizeof(lastFrame));
+
+    GLsizeiptr totalSize = frameSize * frameCount;
+    glGenBuffers(1, &ID);
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+
+    persistent = GLAD_GL_VERSION_4_4 != 0;
+    if (persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, NULL, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+        if (!mapped)
+        {
+            std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+            persistent = false;
+            // immutable storage can't be re-specified, start over with a mutable buffer
+            GLState::ForgetBuffer(ID);
+            glDeleteBuffers(1, &ID);
+            glGenBuffers(1, &ID);
+            GLState::BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        }
+    }
+    if (!persistent)
+        glBufferData(GL_COPY_WRITE_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, ID, MEMORY_STAGING, totalSize, owner);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (unsigned int i = 0; i < MAX_FRAMES; i++)
+    {
+        if (fences[i])
+            glDeleteSync(fences[i]);
+    }
+    if (persistent)
+    {
+        GLState::BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    GLState::ForgetBuffer(ID);
+    MemoryTracker::Release(KIND_BUFFER, ID);
+    glDeleteBuffers(1, &ID);
+}
+
+void StreamBuffer::BeginFrame()
+{
+    lastFrame = currentFrame;
+    memset(&currentFrame, 0, sizeof(currentFrame));
+
+    frameIndex = (frameIndex + 1) % frameCount;
+    head = 0;
+
+    GLsync fence = fences[frameIndex];
+    if (!fence)
+        return;
+
+    // cheap poll first, only a fence that is not signaled yet counts as a stall
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        do
+        {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+        } while (result == GL_TIMEOUT_EXPIRED);
+        std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - start;
+
+        currentFrame.fenceWaits++;
+        currentFrame.fenceWaitMs += waited.count();
+        if (result == GL_WAIT_FAILED)
+            std::cout << "ERROR::STREAM_BUFFER::FENCE_WAIT_FAILED" << std::endl;
+    }
+
+    glDeleteSync(fence);
+    fences[frameIndex] = 0;
+}
+
+void StreamBuffer::EndFrame()
+{
+    if (fences[frameIndex])
+        glDeleteSync(fences[frameIndex]);
+    fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+StreamAllocation StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    StreamAllocation allocation;
+    GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+    if (start + size > frameSize)
+    {
+        // wrapping around would overwrite this frame's data before the GPU read it
+        if (!reportedFull)
+            std::cout << "ERROR::STREAM_BUFFER::FRAME_REGION_FULL " << size << std::endl;
+        reportedFull = true;
+        currentFrame.failedAllocations++;
+        allocation.ptr = NULL;
+        allocation.offset = -1;
+        allocation.size = 0;
+        return allocation;
+    }
+    head = start + size;
+
+    allocation.offset = frameSize * frameIndex + start;
+    allocation.size = size;
+    if (persistent)
+    {
+        allocation.ptr = mapped + allocation.offset;
+    }
+    else
+    {
+        // the fence in BeginFrame() already guarantees the GPU is done with this range
+        GLState::BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        allocation.ptr = glMapBufferRange(GL_COPY_WRITE_BUFFER, allocation.offset, size,
+                                          GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    }
+
+    currentFrame.allocations++;
+    currentFrame.bytes += size;
+    return allocation;
+}
+
+void StreamBuffer::Commit(const StreamAllocation &allocation)
+{
+    if (persistent || allocation.offset < 0)
+        return;
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, ID);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+}
+
+GLintptr StreamBuffer::Write(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+    StreamAllocation allocation = Allocate(size, alignment);
+    if (allocation.offset < 0)
+        return -1;
+    if (allocation.ptr)
+        memcpy(allocation.ptr, data, size);
+    Commit(allocation);
+    return allocation.offset;
+}
+
+bool StreamBuffer::IsPersistent() const
+{
+    return persistent;
+}
+
+const StreamStats &StreamBuffer::LastFrame() const
+{
+    return lastFrame;
+}
+
+void StreamBuffer::WriteStatsJson(std::ostream &out) const
+{
+    out << "{\"persistent\":" << (persistent ? "true" : "false")
+        << ",\"allocations\":" << lastFrame.allocations
+        << ",\"bytes\":" << lastFrame.bytes
+        << ",\"fenceWaits\":" << lastFrame.fenceWaits
+        << ",\"fenceWaitMs\":" << lastFrame.fenceWaitMs
+        << ",\"failedAllocations\":" << lastFrame.failedAllocations << "}";
+}
+
+GLsizeiptr StreamBuffer::UniformAlignment()
+{
+    int alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment > 0 ? alignment : 256;
+}
@@ -0,0 +1,323 @@
+#include "TextRenderer.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// distance between baselines, as a factor of the pixel size
+const float TEXT_LINE_SPACING = 1.2f;
+
+// decodes the UTF-8 sequence starting at i and moves i past it, malformed bytes come out as U+FFFD
+static unsigned int nextCodepoint(const std::string &text, unsigned int &i)
+{
+    unsigned char c = text[i++];
+    if (c < 0x80)
+        return c;
+
+    int extra;
+    unsigned int codepoint;
+    if ((c & 0xE0) == 0xC0)
+    {
+        extra = 1;
+        codepoint = c & 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        extra = 2;
+        codepoint = c & 0x0F;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        extra = 3;
+        codepoint = c & 0x07;
+    }
+    else
+        return 0xFFFD;
+
+    for (int n = 0; n < extra; n++)
+    {
+        if (i >= text.size() || (text[i] & 0xC0) != 0x80)
+            return 0xFFFD;
+        codepoint = (codepoint << 6) | (text[i++] & 0x3F);
+    }
+    return codepoint;
+}
+
+static unsigned short unorm16(float value)
+{
+    return (unsigned short)(value * 65535.0f + 0.5f);
+}
+
+static unsigned char unorm8(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 255;
+    return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+TextRenderer::TextRenderer(Font &font, unsigned int maxQuadsPerFrame)
+    : font(font),
+      shader("src/text_vertex.vs", font.Mode == FONT_SDF ? "src/text_sdf_fragment.fs" : "src/text_fragment.fs"),
+      stream(maxQuadsPerFrame * 4 * sizeof(TextVertex), 3, "text vertices"),
+      maxQuads(maxQuadsPerFrame), screenSize(1.0f), cursor(NULL), quadCount(0), overflowed(false)
+{
+    memset(&frameVertices, 0, sizeof(frameVertices));
+    memset(&currentFrame, 0, sizeof(currentFrame));
+    memset(&lastFrame, 0, sizeof(lastFrame));
+
+    shader.Use();
+    shader.SetInt("glyphs", 0);
+
+    glGenVertexArrays(1, &VAO);
+    GLState::BindVertexArray(VAO);
+
+    // every quad uses the same six indices, so one static buffer covers any frame
+    std::vector<unsigned int> indices(maxQuads * 6);
+    for (unsigned int q = 0; q < maxQuads; q++)
+    {
+        unsigned int v = q * 4;
+        unsigned int* quad = &indices[q * 6];
+        quad[0] = v;
+        quad[1] = v + 1;
+        quad[2] = v + 2;
+        quad[3] = v + 2;
+        quad[4] = v + 3;
+        quad[5] = v;
+    }
+    glGenBuffers(1, &EBO);
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    MemoryTracker::Track(KIND_BUFFER, EBO, MEMORY_FONT, indices.size() * sizeof(unsigned int), "text quad indices");
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+}
+
+TextRenderer::~TextRenderer()
+{
+    GLState::ForgetVertexArray(VAO);
+    glDeleteVertexArrays(1, &VAO);
+    GLState::ForgetBuffer(EBO);
+    MemoryTracker::Release(KIND_BUFFER, EBO);
+    glDeleteBuffers(1, &EBO);
+}
+
+void TextRenderer::BeginFrame(int screenWidth, int screenHeight)
+{
+    screenSize = glm::vec2((float)screenWidth, (float)screenHeight);
+    memset(&currentFrame, 0, sizeof(currentFrame));
+
+    // the whole frame region is mapped up front and quads are written into it as they are laid out
+    stream.BeginFrame();
+    frameVertices = stream.Allocate(maxQuads * 4 * sizeof(TextVertex), StreamBuffer::VERTEX_ALIGNMENT);
+    cursor = (TextVertex*)frameVertices.ptr;
+    quadCount = 0;
+    overflowed = false;
+}
+
+void TextRenderer::Text(const std::string &text, glm::vec2 position, unsigned int pixelSize, glm::vec4 color)
+{
+    // glyphs fetched through GetGlyph() are already kept alive for the frame, no need to track pages
+    layout(text, pixelSize, scratch, NULL);
+    currentFrame.runsLaidOut++;
+    if (!scratch.empty())
+        emit(&scratch[0], scratch.size(), position, color);
+}
+
+int TextRenderer::CreateLabel()
+{
+    int label;
+    if (!freeRuns.empty())
+    {
+        label = freeRuns.back();
+        freeRuns.pop_back();
+    }
+    else
+    {
+        label = runs.size();
+        runs.push_back(Run());
+    }
+
+    Run &run = runs[label];
+    run.text.clear();
+    run.pixelSize = 0;
+    run.generation = 0;
+    run.live = true;
+    run.quads.clear();
+    run.pages.clear();
+    return label;
+}
+
+void TextRenderer::ReleaseLabel(int label)
+{
+    if (!runs[label].live)
+        return;
+    runs[label].live = false;
+    freeRuns.push_back(label);
+}
+
+void TextRenderer::Label(int label, const std::string &text, glm::vec2 position, unsigned int pixelSize, glm::vec4 color)
+{
+    Run &run = runs[label];
+    currentFrame.labels++;
+
+    // pixelSize 0 never matches, a fresh label is always laid out the first time
+    if (run.pixelSize != pixelSize || run.generation != font.Generation() || run.text != text)
+    {
+        run.text = text;
+        run.pixelSize = pixelSize;
+        layout(text, pixelSize, run.quads, &run.pages);
+        run.generation = font.Generation();
+        currentFrame.runsLaidOut++;
+    }
+    else
+    {
+        for (unsigned int i = 0; i < run.pages.size(); i++)
+            font.Touch(run.pages[i]);
+        currentFrame.runsReused++;
+    }
+
+    if (!run.quads.empty())
+        emit(&run.quads[0], run.quads.size(), position, color);
+}
+
+void TextRenderer::Flush()
+{
+    stream.Commit(frameVertices);
+    font.Upload();
+
+    if (quadCount > 0)
+    {
+        GLState::Disable(GL_DEPTH_TEST);
+        GLState::Enable(GL_BLEND);
+        GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        shader.Use();
+        shader.SetFloat2("screenSize", screenSize);
+        GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, font.TextureID());
+        GLState::BindVertexArray(VAO);
+
+        // the frame's vertices sit at a different offset of the ring every frame
+        GLState::BindBuffer(GL_ARRAY_BUFFER, stream.ID);
+        GLintptr base = frameVertices.offset;
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)(base + offsetof(TextVertex, position)));
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(TextVertex), (void*)(base + offsetof(TextVertex, texCoords)));
+        glVertexAttribPointer(2, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(TextVertex), (void*)(base + offsetof(TextVertex, page)));
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void*)(base + offsetof(TextVertex, color)));
+
+        GLState::DrawElements(GL_TRIANGLES, quadCount * 6, GL_UNSIGNED_INT, 0);
+        currentFrame.drawCalls++;
+
+        GLState::Disable(GL_BLEND);
+        GLState::Enable(GL_DEPTH_TEST);
+    }
+
+    stream.EndFrame();
+    currentFrame.quads = quadCount;
+    lastFrame = currentFrame;
+    cursor = NULL;
+}
+
+const TextStats &TextRenderer::LastFrame() const
+{
+    return lastFrame;
+}
+
+void TextRenderer::layout(const std::string &text, unsigned int pixelSize, std::vector<RunQuad> &quads, std::vector<int>* pages)
+{
+    quads.clear();
+    if (pages)
+        pages->clear();
+
+    // SDF glyphs come at one raster size and are scaled, bitmap glyphs are already at pixelSize
+    float scale = (float)pixelSize / (float)font.RasterSize(pixelSize);
+    glm::vec2 pen(0.0f);
+    unsigned int i = 0;
+    while (i < text.size())
+    {
+        unsigned int codepoint = nextCodepoint(text, i);
+        if (codepoint == '\n')
+        {
+            pen.x = 0.0f;
+            pen.y -= pixelSize * TEXT_LINE_SPACING;
+            continue;
+        }
+
+        Glyph glyph = font.GetGlyph(codepoint, pixelSize);
+        if (glyph.page >= 0)
+        {
+            RunQuad quad;
+            quad.min = pen + glm::vec2((float)glyph.bearing.x, (float)(glyph.bearing.y - glyph.size.y)) * scale;
+            quad.max = quad.min + glm::vec2((float)glyph.size.x, (float)glyph.size.y) * scale;
+            quad.texCoords[0] = unorm16(glyph.uv.x);
+            quad.texCoords[1] = unorm16(glyph.uv.y);
+            quad.texCoords[2] = unorm16(glyph.uv.z);
+            quad.texCoords[3] = unorm16(glyph.uv.w);
+            quad.page = (unsigned short)glyph.page;
+            quads.push_back(quad);
+
+            if (pages && (pages->empty() || pages->back() != glyph.page))
+            {
+                bool known = false;
+                for (unsigned int p = 0; p < pages->size() && !known; p++)
+                    known = (*pages)[p] == glyph.page;
+                if (!known)
+                    pages->push_back(glyph.page);
+            }
+        }
+        pen.x += glyph.advance / 64.0f * scale;
+    }
+}
+
+void TextRenderer::emit(const RunQuad* quads, unsigned int count, glm::vec2 position, glm::vec4 color)
+{
+    if (quadCount + count > maxQuads)
+    {
+        if (!overflowed)
+            std::cout << "ERROR::TEXT::FRAME_QUADS_FULL" << std::endl;
+        overflowed = true;
+        count = maxQuads - quadCount;
+    }
+    if (!cursor)
+        return;
+
+    unsigned char rgba[4] = { unorm8(color.x), unorm8(color.y), unorm8(color.z), unorm8(color.w) };
+
+    // the mapped memory is write-only, every field is written once and in order
+    TextVertex* v = cursor;
+    for (unsigned int q = 0; q < count; q++)
+    {
+        const RunQuad &quad = quads[q];
+        glm::vec2 min = position + quad.min;
+        glm::vec2 max = position + quad.max;
+
+        // the atlas stores rows top down, the top of the glyph is at v0
+        v[0].position = min;
+        v[0].texCoords[0] = quad.texCoords[0];
+        v[0].texCoords[1] = quad.texCoords[3];
+        v[1].position = glm::vec2(max.x, min.y);
+        v[1].texCoords[0] = quad.texCoords[2];
+        v[1].texCoords[1] = quad.texCoords[3];
+        v[2].position = max;
+        v[2].texCoords[0] = quad.texCoords[2];
+        v[2].texCoords[1] = quad.texCoords[1];
+        v[3].position = glm::vec2(min.x, max.y);
+        v[3].texCoords[0] = quad.texCoords[0];
+        v[3].texCoords[1] = quad.texCoords[1];
+        for (int corner = 0; corner < 4; corner++)
+        {
+            v[corner].page = quad.page;
+            v[corner].pad = 0;
+            memcpy(v[corner].color, rgba, 4);
+        }
+        v += 4;
+    }
+    cursor = v;
+    quadCount += count;
+}
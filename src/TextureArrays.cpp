@@ -0,0 +1,134 @@
+#include "TextureArrays.h"
+#include "GLState.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+struct PixelFormat
+{
+    GLenum internalFormat;
+    GLenum format;
+};
+
+// by component count, as stb_image returns them
+static const PixelFormat PIXEL_FORMATS[5] = {
+    { GL_RGBA8, GL_RGBA },  // unused
+    { GL_R8, GL_RED },
+    { GL_RG8, GL_RG },
+    { GL_RGB8, GL_RGB },
+    { GL_RGBA8, GL_RGBA }
+};
+
+// images that can share an array: same component count and same size
+struct ImageGroup
+{
+    int components;
+    int width;
+    int height;
+    std::vector<unsigned int> members;
+};
+
+TextureArrays::TextureArrays(const std::string &owner) : owner(owner)
+{
+}
+
+TextureArrays::~TextureArrays()
+{
+    for (unsigned int i = 0; i < arrays.size(); i++)
+    {
+        GLState::ForgetTexture(arrays[i]);
+        MemoryTracker::Release(KIND_TEXTURE, arrays[i]);
+    }
+    if (!arrays.empty())
+        glDeleteTextures(arrays.size(), &arrays[0]);
+}
+
+unsigned int TextureArrays::Add(const unsigned char* pixels, int width, int height, int components)
+{
+    Image image;
+    image.pixels = pixels;
+    image.width = width;
+    image.height = height;
+    image.components = components;
+    image.placed.texture = 0;
+    image.placed.layer = 0;
+    images.push_back(image);
+    return images.size() - 1;
+}
+
+void TextureArrays::Build()
+{
+    PROFILE_ZONE("TextureArrays::Build");
+    int maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    // a model has a handful of distinct sizes, a linear search over the groups is enough
+    std::vector<ImageGroup> groups;
+    for (unsigned int i = 0; i < images.size(); i++)
+    {
+        const Image &image = images[i];
+        if (image.pixels == NULL)
+            continue;
+        unsigned int g = 0;
+        while (g < groups.size() && (groups[g].components != image.components || groups[g].width != image.width ||
+                                     groups[g].height != image.height))
+            g++;
+        if (g == groups.size())
+        {
+            ImageGroup group;
+            group.components = image.components;
+            group.width = image.width;
+            group.height = image.height;
+            groups.push_back(group);
+        }
+        groups[g].members.push_back(i);
+    }
+
+    // rows of an odd sized RGB image aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int g = 0; g < groups.size(); g++)
+    {
+        const std::vector<unsigned int> &members = groups[g].members;
+        int width = groups[g].width;
+        int height = groups[g].height;
+        const PixelFormat &format = PIXEL_FORMATS[groups[g].components];
+        for (unsigned int first = 0; first < members.size(); first += maxLayers)
+        {
+            unsigned int layers = members.size() - first < (unsigned int)maxLayers ? members.size() - first : maxLayers;
+            unsigned int texture;
+            glGenTextures(1, &texture);
+            arrays.push_back(texture);
+            GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format.internalFormat, width, height, layers, 0, format.format, GL_UNSIGNED_BYTE, NULL);
+            for (unsigned int layer = 0; layer < layers; layer++)
+            {
+                Image &image = images[members[first + layer]];
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, format.format, GL_UNSIGNED_BYTE, image.pixels);
+                image.placed.texture = texture;
+                image.placed.layer = layer;
+            }
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            MemoryTracker::Track(KIND_TEXTURE, texture, MEMORY_TEXTURE,
+                                 MemoryTracker::TextureBytes(format.internalFormat, width, height, layers, true), owner);
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // the caller frees the pixels after this
+    for (unsigned int i = 0; i < images.size(); i++)
+        images[i].pixels = NULL;
+}
+
+TextureLayer TextureArrays::Layer(unsigned int image) const
+{
+    return images[image].placed;
+}
+
+unsigned int TextureArrays::ArrayCount() const
+{
+    return arrays.size();
+}
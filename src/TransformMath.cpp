@@ -0,0 +1,117 @@
+#include "TransformMath.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORM_MATH_SSE
+#endif
+
+// relative tolerance used to decide a transform has no shear and the same scale on every axis
+const float UNIFORM_SCALE_EPSILON = 1e-4f;
+
+#ifdef TRANSFORM_MATH_SSE
+
+static inline __m128 cross(__m128 a, __m128 b)
+{
+    // a.yzx * b.zxy - a.zxy * b.yzx
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static inline float dot3(__m128 a, __m128 b)
+{
+    __m128 m = _mm_mul_ps(a, b);
+    __m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2));
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+}
+
+void ComputeNormalMatrices(const glm::mat4 *models, NormalMatrix *normalMatrices, unsigned int count)
+{
+    // drop the w row so translation never leaks into the dot products
+    const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const float *m = &models[i][0][0];
+        __m128 c0 = _mm_and_ps(_mm_loadu_ps(m + 0), xyzMask);
+        __m128 c1 = _mm_and_ps(_mm_loadu_ps(m + 4), xyzMask);
+        __m128 c2 = _mm_and_ps(_mm_loadu_ps(m + 8), xyzMask);
+        float *out = &normalMatrices[i].columns[0].x;
+
+        float l0 = dot3(c0, c0);
+        float l1 = dot3(c1, c1);
+        float l2 = dot3(c2, c2);
+        float tolerance = UNIFORM_SCALE_EPSILON * l0;
+        bool uniformScale = std::fabs(l0 - l1) <= tolerance && std::fabs(l0 - l2) <= tolerance &&
+                            std::fabs(dot3(c0, c1)) <= tolerance && std::fabs(dot3(c0, c2)) <= tolerance &&
+                            std::fabs(dot3(c1, c2)) <= tolerance;
+
+        if (uniformScale && l0 > 0.0f)
+        {
+            __m128 invScale2 = _mm_set1_ps(1.0f / l0);
+            _mm_storeu_ps(out + 0, _mm_mul_ps(c0, invScale2));
+            _mm_storeu_ps(out + 4, _mm_mul_ps(c1, invScale2));
+            _mm_storeu_ps(out + 8, _mm_mul_ps(c2, invScale2));
+            continue;
+        }
+
+        // general case: the inverse transpose is the cofactor matrix over the determinant
+        __m128 r0 = cross(c1, c2);
+        __m128 r1 = cross(c2, c0);
+        __m128 r2 = cross(c0, c1);
+        float det = dot3(c0, r0);
+        __m128 invDet = _mm_set1_ps(det != 0.0f ? 1.0f / det : 0.0f);
+        _mm_storeu_ps(out + 0, _mm_mul_ps(r0, invDet));
+        _mm_storeu_ps(out + 4, _mm_mul_ps(r1, invDet));
+        _mm_storeu_ps(out + 8, _mm_mul_ps(r2, invDet));
+    }
+}
+
+#else
+
+void ComputeNormalMatrices(const glm::mat4 *models, NormalMatrix *normalMatrices, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 c0 = glm::vec3(models[i][0]);
+        glm::vec3 c1 = glm::vec3(models[i][1]);
+        glm::vec3 c2 = glm::vec3(models[i][2]);
+
+        float l0 = glm::dot(c0, c0);
+        float l1 = glm::dot(c1, c1);
+        float l2 = glm::dot(c2, c2);
+        float tolerance = UNIFORM_SCALE_EPSILON * l0;
+        bool uniformScale = std::fabs(l0 - l1) <= tolerance && std::fabs(l0 - l2) <= tolerance &&
+                            std::fabs(glm::dot(c0, c1)) <= tolerance && std::fabs(glm::dot(c0, c2)) <= tolerance &&
+                            std::fabs(glm::dot(c1, c2)) <= tolerance;
+
+        glm::vec3 r0, r1, r2;
+        if (uniformScale && l0 > 0.0f)
+        {
+            r0 = c0 / l0;
+            r1 = c1 / l0;
+            r2 = c2 / l0;
+        }
+        else
+        {
+            r0 = glm::cross(c1, c2);
+            r1 = glm::cross(c2, c0);
+            r2 = glm::cross(c0, c1);
+            float det = glm::dot(c0, r0);
+            float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+            r0 *= invDet;
+            r1 *= invDet;
+            r2 *= invDet;
+        }
+
+        normalMatrices[i].columns[0] = glm::vec4(r0, 0.0f);
+        normalMatrices[i].columns[1] = glm::vec4(r1, 0.0f);
+        normalMatrices[i].columns[2] = glm::vec4(r2, 0.0f);
+    }
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include "TransformStore.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORM_STORE_SSE
+#endif
+
+const unsigned int DIRTY_WORD_BITS = 64;
+// a group is four transforms, the width of an SSE register of floats
+const unsigned int GROUP_SIZE = 4;
+const unsigned long long GROUP_MASK = 0xF;
+
+TransformStore::TransformStore() : count(0), dirtyCount(0)
+{
+}
+
+unsigned int TransformStore::Add(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    unsigned int index = count;
+    if (index % GROUP_SIZE == 0)
+    {
+        // a new group, padded with identity transforms
+        unsigned int size = index + GROUP_SIZE;
+        positionX.resize(size, 0.0f);
+        positionY.resize(size, 0.0f);
+        positionZ.resize(size, 0.0f);
+        rotationX.resize(size, 0.0f);
+        rotationY.resize(size, 0.0f);
+        rotationZ.resize(size, 0.0f);
+        rotationW.resize(size, 1.0f);
+        scaleX.resize(size, 1.0f);
+        scaleY.resize(size, 1.0f);
+        scaleZ.resize(size, 1.0f);
+        worlds.resize(size, glm::mat4(1.0f));
+        normals.resize(size);
+    }
+    if (index % DIRTY_WORD_BITS == 0)
+        dirty.push_back(0);
+    count++;
+
+    SetPosition(index, position);
+    SetRotation(index, rotation);
+    SetScale(index, scale);
+    return index;
+}
+
+void TransformStore::SetPosition(unsigned int index, const glm::vec3 &position)
+{
+    positionX[index] = position.x;
+    positionY[index] = position.y;
+    positionZ[index] = position.z;
+    markDirty(index);
+}
+
+void TransformStore::SetRotation(unsigned int index, const glm::quat &rotation)
+{
+    rotationX[index] = rotation.x;
+    rotationY[index] = rotation.y;
+    rotationZ[index] = rotation.z;
+    rotationW[index] = rotation.w;
+    markDirty(index);
+}
+
+void TransformStore::SetScale(unsigned int index, const glm::vec3 &scale)
+{
+    scaleX[index] = scale.x;
+    scaleY[index] = scale.y;
+    scaleZ[index] = scale.z;
+    markDirty(index);
+}
+
+void TransformStore::MarkAllDirty()
+{
+    for (unsigned int i = 0; i < count; i++)
+        markDirty(i);
+}
+
+void TransformStore::markDirty(unsigned int index)
+{
+    unsigned long long bit = 1ULL << (index % DIRTY_WORD_BITS);
+    unsigned long long &word = dirty[index / DIRTY_WORD_BITS];
+    if ((word & bit) == 0)
+    {
+        word |= bit;
+        dirtyCount++;
+    }
+}
+
+unsigned int TransformStore::Update()
+{
+    if (dirtyCount == 0)
+        return 0;
+    for (unsigned int w = 0; w < dirty.size(); w++)
+    {
+        unsigned long long word = dirty[w];
+        if (word == 0)
+            continue;
+        // a group with any transform set is recomposed whole, the others in it come out the same as before
+        for (unsigned int group = 0; group < DIRTY_WORD_BITS; group += GROUP_SIZE)
+        {
+            if ((word >> group) & GROUP_MASK)
+            {
+                unsigned int first = w * DIRTY_WORD_BITS + group;
+                composeFour(first);
+                ComputeNormalMatrices(&worlds[first], &normals[first], GROUP_SIZE);
+            }
+        }
+        dirty[w] = 0;
+    }
+    unsigned int updated = dirtyCount;
+    dirtyCount = 0;
+    return updated;
+}
+
+unsigned int TransformStore::Count() const
+{
+    return count;
+}
+
+const glm::mat4* TransformStore::WorldMatrices() const
+{
+    return worlds.empty() ? NULL : &worlds[0];
+}
+
+const NormalMatrix* TransformStore::NormalMatrices() const
+{
+    return normals.empty() ? NULL : &normals[0];
+}
+
+// translation * rotation * scale, the quaternion expanded into its matrix the way glm::mat4_cast does
+#ifdef TRANSFORM_STORE_SSE
+
+void TransformStore::composeFour(unsigned int first)
+{
+    // one register per component, holding it for all four transforms
+    __m128 x = _mm_loadu_ps(&rotationX[first]);
+    __m128 y = _mm_loadu_ps(&rotationY[first]);
+    __m128 z = _mm_loadu_ps(&rotationZ[first]);
+    __m128 w = _mm_loadu_ps(&rotationW[first]);
+    __m128 sx = _mm_loadu_ps(&scaleX[first]);
+    __m128 sy = _mm_loadu_ps(&scaleY[first]);
+    __m128 sz = _mm_loadu_ps(&scaleZ[first]);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 x2 = _mm_add_ps(x, x);
+    __m128 y2 = _mm_add_ps(y, y);
+    __m128 z2 = _mm_add_ps(z, z);
+    __m128 xx = _mm_mul_ps(x, x2);
+    __m128 yy = _mm_mul_ps(y, y2);
+    __m128 zz = _mm_mul_ps(z, z2);
+    __m128 xy = _mm_mul_ps(x, y2);
+    __m128 xz = _mm_mul_ps(x, z2);
+    __m128 yz = _mm_mul_ps(y, z2);
+    __m128 wx = _mm_mul_ps(w, x2);
+    __m128 wy = _mm_mul_ps(w, y2);
+    __m128 wz = _mm_mul_ps(w, z2);
+
+    // mCR is row R of column C
+    __m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+    __m128 m01 = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+    __m128 m02 = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+    __m128 m03 = zero;
+    __m128 m10 = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+    __m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+    __m128 m12 = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+    __m128 m13 = zero;
+    __m128 m20 = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+    __m128 m21 = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+    __m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+    __m128 m23 = zero;
+    __m128 m30 = _mm_loadu_ps(&positionX[first]);
+    __m128 m31 = _mm_loadu_ps(&positionY[first]);
+    __m128 m32 = _mm_loadu_ps(&positionZ[first]);
+    __m128 m33 = one;
+
+    // afterwards register N of a column holds that column of transform N
+    _MM_TRANSPOSE4_PS(m00, m01, m02, m03);
+    _MM_TRANSPOSE4_PS(m10, m11, m12, m13);
+    _MM_TRANSPOSE4_PS(m20, m21, m22, m23);
+    _MM_TRANSPOSE4_PS(m30, m31, m32, m33);
+
+    float *out = &worlds[first][0][0];
+    _mm_storeu_ps(out + 0, m00);
+    _mm_storeu_ps(out + 4, m10);
+    _mm_storeu_ps(out + 8, m20);
+    _mm_storeu_ps(out + 12, m30);
+    _mm_storeu_ps(out + 16, m01);
+    _mm_storeu_ps(out + 20, m11);
+    _mm_storeu_ps(out + 24, m21);
+    _mm_storeu_ps(out + 28, m31);
+    _mm_storeu_ps(out + 32, m02);
+    _mm_storeu_ps(out + 36, m12);
+    _mm_storeu_ps(out + 40, m22);
+    _mm_storeu_ps(out + 44, m32);
+    _mm_storeu_ps(out + 48, m03);
+    _mm_storeu_ps(out + 52, m13);
+    _mm_storeu_ps(out + 56, m23);
+    _mm_storeu_ps(out + 60, m33);
+}
+
+#else
+
+void TransformStore::composeFour(unsigned int first)
+{
+    for (unsigned int i = first; i < first + GROUP_SIZE; i++)
+    {
+        float x = rotationX[i], y = rotationY[i], z = rotationZ[i], w = rotationW[i];
+        float xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+        float xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+        float wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+
+        glm::mat4 &world = worlds[i];
+        world[0] = glm::vec4(1.0f - (yy + zz), xy + wz, xz - wy, 0.0f) * scaleX[i];
+        world[1] = glm::vec4(xy - wz, 1.0f - (xx + zz), yz + wx, 0.0f) * scaleY[i];
+        world[2] = glm::vec4(xz + wy, yz - wx, 1.0f - (xx + yy), 0.0f) * scaleZ[i];
+        world[3] = glm::vec4(positionX[i], positionY[i], positionZ[i], 1.0f);
+    }
+}
+
+#endif
@@ -0,0 +1,33 @@
+#include "UniformBuffer.h"
+#include "GLState.h"
+
+UniformBuffer::UniformBuffer(unsigned int bytesPerFrame, unsigned int framesInFlight) : stream(bytesPerFrame, framesInFlight, "uniform stream")
+{
+    ID = stream.ID;
+    alignment = StreamBuffer::UniformAlignment();
+}
+
+void UniformBuffer::BeginFrame()
+{
+    stream.BeginFrame();
+}
+
+void UniformBuffer::EndFrame()
+{
+    stream.EndFrame();
+}
+
+GLintptr UniformBuffer::Push(const void* data, GLsizeiptr size)
+{
+    return stream.Write(data, size, alignment);
+}
+
+void UniformBuffer::Bind(UniformBinding binding, GLintptr offset, GLsizeiptr size) const
+{
+    GLState::BindBufferRange(GL_UNIFORM_BUFFER, binding, ID, offset, size);
+}
+
+const StreamBuffer &UniformBuffer::Stream() const
+{
+    return stream;
+}
@@ -1,55 +1,52 @@
-/*
-#version 330 core
-out vec4 FragColor;
-
-in vec2 TexCoords;
-
-uniform sampler2D texture_diffuse1;
-
-void main()
-{
-    FragColor = texture(texture_diffuse1, TexCoords);
-}
-*/
 #version 330 core
 
 in vec2 TexCoord;
 in vec3 Normal;
 in vec3 WorldPos;
+#ifdef HAS_NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#else
+const vec3 Tangent = vec3(0.0f);
+const vec3 Bitangent = vec3(0.0f);
+#endif
 
 out vec4 FragColor;
 
-// Camera
-uniform vec3 cameraPos;
-
-// Light
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-
-// Material
-struct Material
-{
-    vec3 ambient;
-    sampler2D diffuse;
-    sampler2D specular;
-    vec3 color;
-    float shininess;
-};
-uniform Material material;
+#include "per_frame.glsl"
+#include "lighting.glsl"
+#include "material.glsl"
 
 void main()
 {
-    vec3 ambient = material.ambient * vec3(texture(material.diffuse, TexCoord));
+    vec3 albedo = materialAlbedo(TexCoord);
+    float specularStrength = materialSpecular(TexCoord);
+    vec3 normal = materialNormal(TexCoord, Normal, Tangent, Bitangent);
+    vec3 camDir = normalize(cameraPos - WorldPos);
+
+    vec3 ambient = ambientLight * albedo;
 
     vec3 lightDir = normalize(WorldPos - lightPos);
-    float nDotL = max(dot(Normal, -lightDir), 0.0f);
-    vec3 diffuse = nDotL * vec3(texture(material.diffuse, TexCoord)) * lightColor/2;
+    float nDotL = max(dot(normal, -lightDir), 0.0f);
+    vec3 diffuse = nDotL * albedo * lightColor/2;
 
-    vec3 reflection = normalize(reflect(lightDir, Normal));
-    vec3 camDir = normalize(cameraPos - WorldPos);
+    vec3 reflection = normalize(reflect(lightDir, normal));
     float vDotR = max(dot(camDir, reflection), 0.0f);
-    vec3 specular = vec3(pow(vDotR, material.shininess)) * lightColor/2;
-
-    vec3 color = (ambient + diffuse + specular) * material.color;
+    vec3 specular = vec3(pow(vDotR, materialShininess())) * specularStrength * lightColor/2;
+
+    // every point light for every fragment, the cost the deferred path avoids
+    for (int i = 0; i < pointLightCount; i++)
+    {
+        vec3 toLight = pointLights[i].position - WorldPos;
+        float dist = length(toLight);
+        if (dist >= pointLights[i].radius)
+            continue;
+        vec3 l = toLight / dist;
+        vec3 radiance = pointLights[i].color * attenuation(dist, pointLights[i].radius);
+        diffuse += max(dot(normal, l), 0.0f) * albedo * radiance;
+        specular += pow(max(dot(camDir, reflect(-l, normal)), 0.0f), materialShininess()) * specularStrength * radiance;
+    }
+
+    vec3 color = ambient + diffuse + specular;
     FragColor = vec4(color, 1.0f);
 }
@@ -1,41 +1,38 @@
-/*
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
-
-out vec2 TexCoords;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float time;
-
-void main()
-{
-    TexCoords = aTexCoords;
-    vec3 newPos = aPos + vec3(sin(aPos.y * 10.0 + time*5.0)/20, 0.0, 0.0);
-    gl_Position = projection * view * model * vec4(newPos, 1.0);
-}
-*/
 #version 330 core
 layout (location = 0) in vec3 aPos; // "a" for "attribute"
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+#ifdef HAS_NORMAL_MAP
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+layout (location = 5) in uint aMaterial; // index of the mesh's material in MaterialBlock
+layout (location = 6) in uint aNode; // index of the mesh's node in Nodes
 
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 WorldPos;
+flat out uint MaterialIndex;
+#ifdef HAS_NORMAL_MAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "per_frame.glsl"
+#include "object.glsl"
+#include "nodes.glsl"
 
 void main()
 {
+   // the mesh is in its node's space, the node in the model's
+   mat3 meshNormalMatrix = normalMatrix * nodes[aNode].normalMatrix;
    TexCoord = aTexCoord;
-   Normal = mat3(transpose(inverse(model))) * aNormal; // correction for world space
-   WorldPos = vec3(model * vec4(aPos, 1.0));
-   gl_Position = projection * view * model * vec4(aPos, 1.0);
+   MaterialIndex = aMaterial;
+   Normal = meshNormalMatrix * aNormal; // correction for world space
+#ifdef HAS_NORMAL_MAP
+   Tangent = meshNormalMatrix * aTangent;
+   Bitangent = meshNormalMatrix * aBitangent;
+#endif
+   WorldPos = vec3(model * (nodes[aNode].world * vec4(aPos, 1.0)));
+   gl_Position = viewProjection * vec4(WorldPos, 1.0);
 }
-
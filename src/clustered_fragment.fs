@@ -0,0 +1,75 @@
+#version 330 core
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 WorldPos;
+#ifdef HAS_NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#else
+const vec3 Tangent = vec3(0.0f);
+const vec3 Bitangent = vec3(0.0f);
+#endif
+
+out vec4 FragColor;
+
+#include "per_frame.glsl"
+#include "lighting.glsl"
+#include "material.glsl"
+
+// Clusters, filled by LightClusters every frame
+// grid: per froxel the offset and count of its lights in the index list
+// lights: two texels per light, position and radius then color
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform samplerBuffer clusterLights;
+uniform int clusterGridBase;
+uniform int clusterIndexBase;
+uniform int clusterLightBase;
+uniform vec2 clusterTileScale;     // froxel tiles per pixel
+uniform vec2 clusterDepthParams;   // slice = log(depth) * x + y
+
+void main()
+{
+    vec3 albedo = materialAlbedo(TexCoord);
+    float specularStrength = materialSpecular(TexCoord);
+    vec3 normal = materialNormal(TexCoord, Normal, Tangent, Bitangent);
+    vec3 camDir = normalize(cameraPos - WorldPos);
+
+    vec3 ambient = ambientLight * albedo;
+
+    vec3 lightDir = normalize(WorldPos - lightPos);
+    float nDotL = max(dot(normal, -lightDir), 0.0f);
+    vec3 diffuse = nDotL * albedo * lightColor/2;
+
+    vec3 reflection = normalize(reflect(lightDir, normal));
+    float vDotR = max(dot(camDir, reflection), 0.0f);
+    vec3 specular = vec3(pow(vDotR, materialShininess())) * specularStrength * lightColor/2;
+
+    // only the lights binned into this fragment's froxel
+    vec3 viewPos = vec3(view * vec4(WorldPos, 1.0f));
+    int slice = clamp(int(log(-viewPos.z) * clusterDepthParams.x + clusterDepthParams.y), 0, CLUSTER_Z - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterTileScale), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    uvec2 cell = texelFetch(clusterGrid, clusterGridBase + (slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x).rg;
+    for (uint i = 0u; i < cell.y; i++)
+    {
+        int light = clusterLightBase + 2 * int(texelFetch(clusterIndices, clusterIndexBase + int(cell.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, light);
+        vec3 lightColor = texelFetch(clusterLights, light + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - WorldPos;
+        float dist = length(toLight);
+        if (dist >= positionRadius.w)
+            continue;
+        vec3 l = toLight / dist;
+        vec3 radiance = lightColor * attenuation(dist, positionRadius.w);
+        diffuse += max(dot(normal, l), 0.0f) * albedo * radiance;
+        specular += pow(max(dot(camDir, reflect(-l, normal)), 0.0f), materialShininess()) * specularStrength * radiance;
+    }
+
+    vec3 color = ambient + diffuse + specular;
+    FragColor = vec4(color, 1.0f);
+}
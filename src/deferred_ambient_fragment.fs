@@ -0,0 +1,53 @@
+#version 330 core
+
+out vec4 FragColor;
+
+#include "per_frame.glsl"
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+vec3 decodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0f - 1.0f;
+    vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = clamp(-n.z, 0.0f, 1.0f);
+    n.xy += vec2(n.x >= 0.0f ? -fold : fold, n.y >= 0.0f ? -fold : fold);
+    return normalize(n);
+}
+
+// ambient and the scene light, the same terms basic_fragment.fs adds before its point lights
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing was drawn here, keep the clear color
+    if (depth == 1.0f)
+        discard;
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec3 albedo = albedoSpecular.rgb;
+    vec4 normalShininess = texelFetch(gNormal, pixel, 0);
+    vec3 normal = decodeNormal(normalShininess.rg);
+    float shininess = normalShininess.b * MAX_SHININESS;
+    vec4 world = inverseViewProjection * vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+    vec3 worldPos = world.xyz / world.w;
+
+    vec3 ambient = ambientLight * albedo;
+
+    vec3 lightDir = normalize(worldPos - lightPos);
+    float nDotL = max(dot(normal, -lightDir), 0.0f);
+    vec3 diffuse = nDotL * albedo * lightColor/2;
+
+    vec3 reflection = normalize(reflect(lightDir, normal));
+    vec3 camDir = normalize(cameraPos - worldPos);
+    float vDotR = max(dot(camDir, reflection), 0.0f);
+    vec3 specular = vec3(pow(vDotR, shininess)) * albedoSpecular.a * lightColor/2;
+
+    FragColor = vec4(ambient + diffuse + specular, 1.0f);
+    // the forward passes drawn after this one depth test against the scene
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,50 @@
+#version 330 core
+
+flat in vec4 LightPositionRadius;
+flat in vec3 LightColor;
+
+out vec4 FragColor;
+
+#include "per_frame.glsl"
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+vec3 decodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0f - 1.0f;
+    vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = clamp(-n.z, 0.0f, 1.0f);
+    n.xy += vec2(n.x >= 0.0f ? -fold : fold, n.y >= 0.0f ? -fold : fold);
+    return normalize(n);
+}
+
+// one point light for the pixels its volume covers, added on top of the ambient pass
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    vec4 world = inverseViewProjection * vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+    vec3 worldPos = world.xyz / world.w;
+
+    vec3 toLight = LightPositionRadius.xyz - worldPos;
+    float dist = length(toLight);
+    // the volume only bounds the light, pixels in its corners are still out of reach
+    if (dist >= LightPositionRadius.w)
+        discard;
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec4 normalShininess = texelFetch(gNormal, pixel, 0);
+    vec3 normal = decodeNormal(normalShininess.rg);
+    float shininess = normalShininess.b * MAX_SHININESS;
+    vec3 l = toLight / dist;
+    vec3 camDir = normalize(cameraPos - worldPos);
+    vec3 radiance = LightColor * attenuation(dist, LightPositionRadius.w);
+
+    vec3 diffuse = max(dot(normal, l), 0.0f) * albedoSpecular.rgb * radiance;
+    vec3 specular = pow(max(dot(camDir, reflect(-l, normal)), 0.0f), shininess) * albedoSpecular.a * radiance;
+    FragColor = vec4(diffuse + specular, 1.0f);
+}
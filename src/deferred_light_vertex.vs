@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;                 // unit sphere
+layout (location = 1) in vec4 aLightPositionRadius; // per instance
+layout (location = 2) in vec3 aLightColor;          // per instance
+
+flat out vec4 LightPositionRadius;
+flat out vec3 LightColor;
+
+#include "per_frame.glsl"
+
+void main()
+{
+    LightPositionRadius = aLightPositionRadius;
+    LightColor = aLightColor;
+    gl_Position = viewProjection * vec4(aLightPositionRadius.xyz + aPos * aLightPositionRadius.w, 1.0f);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+// one triangle covering the screen, generated from the vertex index so no buffer is needed
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,3 @@
+// G-buffer, shared by the geometry pass that writes it and the passes that read it back
+// shininess is stored as shininess / MAX_SHININESS next to the normal; Ns in .mtl files runs up to 1000
+const float MAX_SHININESS = 1000.0f;
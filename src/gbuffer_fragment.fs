@@ -0,0 +1,38 @@
+#version 330 core
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 WorldPos;
+#ifdef HAS_NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#else
+const vec3 Tangent = vec3(0.0f);
+const vec3 Bitangent = vec3(0.0f);
+#endif
+
+// 8 bytes per pixel plus depth, positions are rebuilt from the depth buffer
+layout (location = 0) out vec4 AlbedoSpecular;      // rgb albedo, a specular strength
+layout (location = 1) out vec4 NormalShininess;     // rg octahedral encoded world space normal, b shininess / MAX_SHININESS
+
+#include "material.glsl"
+#include "gbuffer.glsl"
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// folds the unit sphere onto an octahedron and the octahedron onto a square, two channels keep the normal
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = n.z >= 0.0f ? n.xy : (1.0f - abs(n.yx)) * signNotZero(n.xy);
+    return folded * 0.5f + 0.5f;
+}
+
+void main()
+{
+    AlbedoSpecular = vec4(materialAlbedo(TexCoord), materialSpecular(TexCoord));
+    NormalShininess = vec4(encodeNormal(materialNormal(TexCoord, Normal, Tangent, Bitangent)), materialShininess() / MAX_SHININESS, 0.0f);
+}
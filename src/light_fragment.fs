@@ -2,10 +2,10 @@
 
 out vec4 FragColor;
 
-uniform vec3 color;
+#include "lighting.glsl"
 
 void main()
 {
-    FragColor = vec4(color, 1.0f);
+    FragColor = vec4(lightColor, 1.0f);
 }
 
@@ -0,0 +1,26 @@
+// Light
+const int MAX_FORWARD_LIGHTS = 256;
+
+struct PointLight
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+};
+
+layout (std140) uniform Lighting
+{
+    vec3 lightPos;
+    vec3 lightColor;
+    int pointLightCount;
+    vec3 ambientLight;
+    PointLight pointLights[MAX_FORWARD_LIGHTS];
+};
+
+// reaches exactly zero at the radius so a light can be skipped past it
+float attenuation(float dist, float radius)
+{
+    float ratio = dist / radius;
+    float window = clamp(1.0f - ratio * ratio * ratio * ratio, 0.0f, 1.0f);
+    return window * window / (dist * dist + 1.0f);
+}
@@ -0,0 +1,76 @@
+// Material
+// samplers can't live in a uniform block, so the maps stay plain uniforms. The maps a mesh doesn't have
+// are left out by ShaderPermutations instead of sampling a placeholder. Each map is a texture array shared
+// by the meshes of a batch, the mesh's layer in it comes with its vertices. A material without any map has
+// no samplers at all, and GLSL has no empty structs
+#if defined(HAS_DIFFUSE_MAP) || defined(HAS_SPECULAR_MAP) || defined(HAS_NORMAL_MAP)
+struct MaterialMaps
+{
+#ifdef HAS_DIFFUSE_MAP
+    sampler2DArray diffuse;
+#endif
+#ifdef HAS_SPECULAR_MAP
+    sampler2DArray specular;
+#endif
+#ifdef HAS_NORMAL_MAP
+    sampler2DArray normal;
+#endif
+};
+uniform MaterialMaps material;
+#endif
+
+// every material of the model being drawn, picked by the index its meshes' vertices carry. Ns, Kd and Ks
+// come from the model's .mtl file, layers are where its maps were packed in the texture arrays
+const int MAX_MATERIALS = 341;    // as many as fit in 16KB, the same as in UniformBuffer.h
+
+struct MaterialParams
+{
+    vec3 diffuse;
+    float shininess;
+    vec3 specular;
+    uvec4 layers;       // diffuse, specular, normal
+};
+
+layout (std140) uniform MaterialBlock
+{
+    MaterialParams materials[MAX_MATERIALS];
+};
+flat in uint MaterialIndex;
+
+// without a map the albedo is Kd alone
+vec3 materialAlbedo(vec2 uv)
+{
+#ifdef HAS_DIFFUSE_MAP
+    return vec3(texture(material.diffuse, vec3(uv, materials[MaterialIndex].layers.x))) * materials[MaterialIndex].diffuse;
+#else
+    return materials[MaterialIndex].diffuse;
+#endif
+}
+
+// without a map the surface has no highlights, the specular terms fold away. The G-buffer keeps one channel
+// of specular, so Ks is taken as grey on every path
+float materialSpecular(vec2 uv)
+{
+#ifdef HAS_SPECULAR_MAP
+    vec3 specular = materials[MaterialIndex].specular;
+    return texture(material.specular, vec3(uv, materials[MaterialIndex].layers.y)).r * (specular.r + specular.g + specular.b) / 3.0f;
+#else
+    return 0.0f;
+#endif
+}
+
+float materialShininess()
+{
+    return materials[MaterialIndex].shininess;
+}
+
+// world space normal; tangent and bitangent only matter with a normal map
+vec3 materialNormal(vec2 uv, vec3 normal, vec3 tangent, vec3 bitangent)
+{
+#ifdef HAS_NORMAL_MAP
+    vec3 tangentNormal = texture(material.normal, vec3(uv, materials[MaterialIndex].layers.z)).rgb * 2.0f - 1.0f;
+    return normalize(mat3(normalize(tangent), normalize(bitangent), normalize(normal)) * tangentNormal);
+#else
+    return normalize(normal);
+#endif
+}
@@ -0,0 +1,15 @@
+// Nodes
+// the nodes of the model being drawn that carry meshes, picked by the index their meshes' vertices carry.
+// A node's matrices take its meshes into the model's space, through every ancestor in the file
+const int MAX_MESH_NODES = 128;
+
+struct Node
+{
+    mat4 world;
+    mat3 normalMatrix;
+};
+
+layout (std140) uniform Nodes
+{
+    Node nodes[MAX_MESH_NODES];
+};
@@ -0,0 +1,5 @@
+layout (std140) uniform Object
+{
+    mat4 model;
+    mat3 normalMatrix; // inverse transpose of model, computed once per object on the CPU
+};
@@ -0,0 +1,10 @@
+// Camera, filled once per frame from PerFrameBlock
+layout (std140) uniform PerFrame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 cameraPos;
+    float time;
+    mat4 inverseViewProjection;
+};
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 TexCoords;
+in vec4 Color;
+
+out vec4 FragColor;
+
+uniform sampler2DArray glyphs;
+
+void main()
+{
+    FragColor = vec4(Color.rgb, Color.a * texture(glyphs, TexCoords).r);
+}
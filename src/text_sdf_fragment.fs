@@ -0,0 +1,20 @@
+#version 330 core
+
+in vec3 TexCoords;
+in vec4 Color;
+
+out vec4 FragColor;
+
+uniform sampler2DArray glyphs;
+
+// the outline sits at 0.5, distances grow inwards
+const float EDGE = 0.5f;
+
+void main()
+{
+    float distance = texture(glyphs, TexCoords).r;
+    // antialias over about one screen pixel whatever size the glyph is drawn at
+    float width = fwidth(distance) * 0.7f;
+    float alpha = smoothstep(EDGE - width, EDGE + width, distance);
+    FragColor = vec4(Color.rgb, Color.a * alpha);
+}
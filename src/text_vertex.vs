@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;         // in pixels, origin at the bottom left of the screen
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in float aPage;       // atlas layer
+layout (location = 3) in vec4 aColor;
+
+out vec3 TexCoords;
+out vec4 Color;
+
+uniform vec2 screenSize;
+
+void main()
+{
+    TexCoords = vec3(aTexCoords, aPage);
+    Color = aColor;
+    gl_Position = vec4(aPos / screenSize * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,372 @@
+// Tests and benchmark of the job system, built by the JobSystemTests target on its own without GL.
+// Runs the tests and exits with the number of failed checks; --bench also measures the per job overhead
+// and how a parallel_for scales over the cores, one JSON line per thread count.
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+const unsigned int TEST_THREADS = 4;
+// how long a job sleeps when the others are meant to steal meanwhile
+const std::chrono::milliseconds STEAL_SLEEP(2);
+const unsigned int JOB_BENCH_JOBS = 200000;
+const unsigned int JOB_BENCH_ITEMS = 1 << 20;
+
+static unsigned int failures = 0;
+
+static void check(bool condition, const char* test, const std::string &what)
+{
+    if (condition)
+        return;
+    std::cout << "FAILED::" << test << " " << what << std::endl;
+    failures++;
+}
+
+// ---- JOBS ----
+
+static void increment(void* data)
+{
+    ((std::atomic<int>*)data)->fetch_add(1);
+}
+
+static void emptyJob(void*)
+{
+}
+
+struct StealData
+{
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+};
+
+static void sleepAndRecord(void* data)
+{
+    StealData* steal = (StealData*)data;
+    std::this_thread::sleep_for(STEAL_SLEEP);
+    std::lock_guard<std::mutex> lock(steal->mutex);
+    steal->threads.insert(std::this_thread::get_id());
+}
+
+struct OrderData
+{
+    std::atomic<int> firstDone;
+    std::atomic<int> ranTooEarly;
+    std::atomic<int> ran;
+};
+
+static void slowFirst(void* data)
+{
+    std::this_thread::sleep_for(STEAL_SLEEP);
+    ((OrderData*)data)->firstDone.store(1);
+}
+
+static void afterFirst(void* data)
+{
+    OrderData* order = (OrderData*)data;
+    if (!order->firstDone.load())
+        order->ranTooEarly.fetch_add(1);
+    order->ran.fetch_add(1);
+}
+
+struct NestedData
+{
+    JobSystem* jobs;
+    std::atomic<int> leaves;
+};
+
+static void nestedLeaf(void* data)
+{
+    ((NestedData*)data)->leaves.fetch_add(1);
+}
+
+static void nestedParent(void* data)
+{
+    // a job waiting on jobs of its own runs them meanwhile instead of blocking a worker
+    NestedData* nested = (NestedData*)data;
+    JobCounter children;
+    for (int i = 0; i < 16; i++)
+        nested->jobs->Run(nestedLeaf, nested, &children);
+    nested->jobs->Wait(&children);
+}
+
+struct MainThreadData
+{
+    JobSystem* jobs;
+    JobCounter* counter;
+    std::thread::id mainThread;
+    std::atomic<int> ran;
+    std::atomic<int> offMainThread;
+};
+
+static void recordMainThread(void* data)
+{
+    MainThreadData* main = (MainThreadData*)data;
+    if (std::this_thread::get_id() != main->mainThread)
+        main->offMainThread.fetch_add(1);
+    main->ran.fetch_add(1);
+}
+
+static void queueOnMainThread(void* data)
+{
+    MainThreadData* main = (MainThreadData*)data;
+    main->jobs->RunOnMainThread(recordMainThread, main, main->counter);
+}
+
+// ---- TESTS ----
+
+static void testCounters(JobSystem &jobs)
+{
+    std::atomic<int> ran(0);
+    JobCounter counter;
+    check(counter.Done(), "counters", "a new counter is done");
+    for (int i = 0; i < 1000; i++)
+        jobs.Run(increment, &ran, &counter);
+    jobs.Wait(&counter);
+    check(counter.Done(), "counters", "done after Wait");
+    check(ran.load() == 1000, "counters", "ran " + std::to_string(ran.load()) + " of 1000");
+
+    // reused once done
+    for (int i = 0; i < 10; i++)
+        jobs.Run(increment, &ran, &counter);
+    jobs.Wait(&counter);
+    check(ran.load() == 1010, "counters", "reused counter ran " + std::to_string(ran.load() - 1000) + " of 10");
+}
+
+static void testStealing(JobSystem &jobs)
+{
+    // every job is pushed to thread 0's deque, the others only get to them by stealing
+    StealData steal;
+    JobCounter counter;
+    for (unsigned int i = 0; i < 8 * jobs.ThreadCount(); i++)
+        jobs.Run(sleepAndRecord, &steal, &counter);
+    jobs.Wait(&counter);
+    if (jobs.ThreadCount() > 1)
+        check(steal.threads.size() > 1, "stealing", "all jobs ran on " + std::to_string(steal.threads.size()) + " thread");
+}
+
+static void testContinuations(JobSystem &jobs)
+{
+    OrderData order;
+    order.firstDone = 0;
+    order.ranTooEarly = 0;
+    order.ran = 0;
+    JobCounter first;
+    JobCounter second;
+    jobs.Run(slowFirst, &order, &first);
+    for (int i = 0; i < 100; i++)
+        jobs.Run(afterFirst, &order, &second, &first);
+    jobs.Wait(&second);
+    check(first.Done(), "continuations", "dependency done once its continuations are");
+    check(order.ran.load() == 100, "continuations", "ran " + std::to_string(order.ran.load()) + " of 100");
+    check(order.ranTooEarly.load() == 0, "continuations", std::to_string(order.ranTooEarly.load()) + " ran before their dependency");
+
+    // a dependency that is already done doesn't hold the job back
+    std::atomic<int> ran(0);
+    JobCounter third;
+    jobs.Run(increment, &ran, &third, &first);
+    jobs.Wait(&third);
+    check(ran.load() == 1, "continuations", "job on a finished dependency ran");
+
+    NestedData nested;
+    nested.jobs = &jobs;
+    nested.leaves = 0;
+    JobCounter parents;
+    for (int i = 0; i < 32; i++)
+        jobs.Run(nestedParent, &nested, &parents);
+    jobs.Wait(&parents);
+    check(nested.leaves.load() == 32 * 16, "continuations", "nested waits ran " + std::to_string(nested.leaves.load()) + " of 512");
+}
+
+static void testSlotExhaustion(JobSystem &jobs)
+{
+    // more jobs parked on an unfinished dependency than a thread has slots, plus as many plain ones
+    OrderData order;
+    order.firstDone = 0;
+    order.ranTooEarly = 0;
+    order.ran = 0;
+    unsigned int parked = 3 * JobSystem::MAX_JOBS_PER_THREAD;
+    JobCounter first;
+    JobCounter done;
+    jobs.Run(slowFirst, &order, &first);
+    for (unsigned int i = 0; i < parked; i++)
+        jobs.Run(afterFirst, &order, &done, &first);
+    std::atomic<int> ran(0);
+    for (unsigned int i = 0; i < parked; i++)
+        jobs.Run(increment, &ran, &done);
+    jobs.Wait(&done);
+    check(order.ran.load() == (int)parked, "slot exhaustion", "continuations ran " + std::to_string(order.ran.load()) + " of " + std::to_string(parked));
+    check(order.ranTooEarly.load() == 0, "slot exhaustion", std::to_string(order.ranTooEarly.load()) + " ran before their dependency");
+    check(ran.load() == (int)parked, "slot exhaustion", "jobs ran " + std::to_string(ran.load()) + " of " + std::to_string(parked));
+}
+
+static void testMainThread(JobSystem &jobs)
+{
+    JobCounter mainJobs;
+    MainThreadData main;
+    main.jobs = &jobs;
+    main.counter = &mainJobs;
+    main.mainThread = std::this_thread::get_id();
+    main.ran = 0;
+    main.offMainThread = 0;
+
+    // nothing but a pump runs them, however long they wait
+    for (int i = 0; i < 10; i++)
+        jobs.RunOnMainThread(recordMainThread, &main, &mainJobs);
+    std::this_thread::sleep_for(STEAL_SLEEP);
+    check(!mainJobs.Done() && main.ran.load() == 0, "main thread", std::to_string(main.ran.load()) + " ran before a pump");
+    jobs.PumpMainThread();
+    check(mainJobs.Done(), "main thread", "done after PumpMainThread");
+    check(main.ran.load() == 10, "main thread", "pump ran " + std::to_string(main.ran.load()) + " of 10");
+
+    // a pump from another thread is refused and leaves the jobs queued
+    jobs.RunOnMainThread(recordMainThread, &main, &mainJobs);
+    std::thread other([&jobs]() { jobs.PumpMainThread(); });
+    other.join();
+    check(!mainJobs.Done() && main.ran.load() == 10, "main thread", "a pump off thread 0 ran the job");
+    jobs.PumpMainThread();
+    check(main.ran.load() == 11, "main thread", "job left by the refused pump didn't run");
+
+    // queued from jobs on whichever thread, run by thread 0 while it waits
+    JobCounter queued;
+    for (int i = 0; i < 100; i++)
+        jobs.Run(queueOnMainThread, &main, &queued);
+    jobs.Wait(&queued);
+    jobs.Wait(&mainJobs);
+    check(mainJobs.Done(), "main thread", "done after Wait");
+    check(main.ran.load() == 111, "main thread", "queued from jobs ran " + std::to_string(main.ran.load() - 11) + " of 100");
+    check(main.offMainThread.load() == 0, "main thread", std::to_string(main.offMainThread.load()) + " ran off thread 0");
+}
+
+static void testParallelFor(JobSystem &jobs, unsigned int count, unsigned int grain)
+{
+    std::string name = "count " + std::to_string(count) + " grain " + std::to_string(grain);
+    std::vector<std::atomic<int> > hits(count);
+    for (unsigned int i = 0; i < count; i++)
+        hits[i] = 0;
+    std::atomic<int> calls(0);
+    std::atomic<int> oversized(0);
+    std::atomic<int> outOfRange(0);
+    jobs.ParallelFor(count, grain, [&](unsigned int begin, unsigned int end)
+    {
+        calls.fetch_add(1);
+        if (end - begin > grain)
+            oversized.fetch_add(1);
+        if (begin >= end || end > count)
+        {
+            outOfRange.fetch_add(1);
+            return;
+        }
+        for (unsigned int i = begin; i < end; i++)
+            hits[i].fetch_add(1);
+    });
+
+    unsigned int wrong = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (hits[i].load() != 1)
+            wrong++;
+    }
+    check(wrong == 0, "parallel for", name + ": " + std::to_string(wrong) + " items not covered exactly once");
+    check(oversized.load() == 0, "parallel for", name + ": " + std::to_string(oversized.load()) + " chunks over the grain");
+    check(outOfRange.load() == 0, "parallel for", name + ": " + std::to_string(outOfRange.load()) + " empty or out of range chunks");
+    if (count == 0)
+        check(calls.load() == 0, "parallel for", name + ": body called on nothing");
+    if (count > 0 && count <= grain)
+        check(calls.load() == 1, "parallel for", name + ": " + std::to_string(calls.load()) + " calls for one chunk");
+}
+
+static void runTests()
+{
+    for (unsigned int threads = 0; threads < TEST_THREADS; threads += TEST_THREADS - 1)
+    {
+        // no workers at all, then a few
+        JobSystem jobs(threads);
+        testCounters(jobs);
+        testStealing(jobs);
+        testContinuations(jobs);
+        testSlotExhaustion(jobs);
+        testMainThread(jobs);
+        testParallelFor(jobs, 0, 64);
+        testParallelFor(jobs, 1, 64);
+        testParallelFor(jobs, 63, 64);
+        testParallelFor(jobs, 64, 64);
+        testParallelFor(jobs, 65, 64);
+        testParallelFor(jobs, 1000, 64);
+        testParallelFor(jobs, 100000, 7);
+        testParallelFor(jobs, 10, 1);
+    }
+}
+
+// ---- BENCHMARK ----
+
+// one JSON line per thread count: the cost of starting, running and waiting on an empty job, and how
+// a parallel_for over arithmetic heavy items scales against a single thread
+static void benchmarkJobs()
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    if (cores == 0)
+        cores = 1;
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < cores; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(cores);
+
+    std::vector<float> items(JOB_BENCH_ITEMS);
+    double singleThreadMs = 0.0;
+    for (unsigned int t = 0; t < threadCounts.size(); t++)
+    {
+        JobSystem jobs(threadCounts[t] - 1);
+
+        // batches stay below the deque size, a full deque would run the jobs inline and skew the number
+        JobCounter counter;
+        unsigned int batch = JobSystem::MAX_JOBS_PER_THREAD / 2;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned int started = 0; started < JOB_BENCH_JOBS; started += batch)
+        {
+            for (unsigned int i = 0; i < batch; i++)
+                jobs.Run(emptyJob, NULL, &counter);
+            jobs.Wait(&counter);
+        }
+        double emptyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        unsigned int emptyJobs = (JOB_BENCH_JOBS + batch - 1) / batch * batch;
+
+        start = std::chrono::steady_clock::now();
+        jobs.ParallelFor(JOB_BENCH_ITEMS, 1024, [&items](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                float x = (float)i;
+                for (int k = 0; k < 64; k++)
+                    x = sqrtf(x * 0.5f + 1.0f);
+                items[i] = x;
+            }
+        });
+        double parallelForMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (t == 0)
+            singleThreadMs = parallelForMs;
+
+        std::cout << "{\"threads\":" << jobs.ThreadCount()
+                  << ",\"emptyJobNs\":" << emptyNs / emptyJobs
+                  << ",\"parallelForMs\":" << parallelForMs
+                  << ",\"speedup\":" << singleThreadMs / parallelForMs
+                  << ",\"checksum\":" << items[JOB_BENCH_ITEMS - 1] << "}" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    runTests();
+    std::cout << (failures == 0 ? "all job system tests passed" : "job system tests failed") << std::endl;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--bench")
+            benchmarkJobs();
+    }
+    return failures;
+}